@@ -11,17 +11,103 @@
 #import "ICSStyleManager.h"
 
 
+#if defined(ICS_STYLE_MANAGER_BENCHMARK)
+
+// Number of keys of the style used to benchmark the key table: the style and its
+// key table are written by the Run Script build phase of the example target when
+// ICS_STYLE_MANAGER_BENCHMARK is defined, as 100 groups of 100 values
+static const NSUInteger ICSSMExampleBenchmarkGroupCount = 100;
+static const NSUInteger ICSSMExampleBenchmarkGroupSize = 100;
+
+// Number of times each key is read during the benchmark
+static const NSUInteger ICSSMExampleBenchmarkRepeatCount = 20;
+
+// Reads all the given keys from a style manager and returns the elapsed time
+static CFTimeInterval ICSSMExampleBenchmarkReads(ICSStyleManager *styleManager, NSArray *keys) {
+    CGFloat sum = 0;
+    CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+    
+    for (NSUInteger i = 0; i < ICSSMExampleBenchmarkRepeatCount; i++) {
+        for (NSString *key in keys) {
+            sum += [styleManager floatForKey:key];
+        }
+    }
+    
+    CFTimeInterval elapsed = CFAbsoluteTimeGetCurrent() - start;
+    
+    // logging the sum keeps the reads from being optimized away
+    NSLog(@"Benchmark reads done (sum of the values: %.0f)", sum);
+    return elapsed;
+}
+
+// Compares reading 10k keys through the regular storage and through a key table
+static void ICSSMExampleRunKeyTableBenchmark(void) {
+    NSMutableArray *keys = [[NSMutableArray alloc] initWithCapacity:ICSSMExampleBenchmarkGroupCount * ICSSMExampleBenchmarkGroupSize];
+    for (NSUInteger i = 0; i < ICSSMExampleBenchmarkGroupCount; i++) {
+        for (NSUInteger j = 0; j < ICSSMExampleBenchmarkGroupSize; j++) {
+            [keys addObject:[NSString stringWithFormat:@"benchmarkViewController%lu.tableView.cell.valueNumber%lu", (unsigned long)i, (unsigned long)j]];
+        }
+    }
+    
+    // read the keys in a random order, so that the lookups don't benefit from locality
+    for (NSUInteger i = keys.count - 1; i > 0; i--) {
+        [keys exchangeObjectAtIndex:i withObjectAtIndex:arc4random_uniform((uint32_t)(i + 1))];
+    }
+    
+    NSBundle *bundle = [NSBundle mainBundle];
+    
+    ICSStyleManager *dictionaryManager = [[ICSStyleManager alloc] init];
+    [dictionaryManager loadStyle:@"Benchmark" fromBundle:bundle];
+    
+    ICSStyleManager *keyTableManager = [[ICSStyleManager alloc] init];
+    [keyTableManager loadStyle:@"Benchmark" fromBundle:bundle];
+    [keyTableManager loadKeyTable:@"Benchmark" fromBundle:bundle];
+    
+    // warm up both managers (the key table is filled on the first read)
+    ICSSMExampleBenchmarkReads(dictionaryManager, keys);
+    ICSSMExampleBenchmarkReads(keyTableManager, keys);
+    
+    CFTimeInterval dictionaryTime = ICSSMExampleBenchmarkReads(dictionaryManager, keys);
+    CFTimeInterval keyTableTime = ICSSMExampleBenchmarkReads(keyTableManager, keys);
+    NSUInteger readCount = keys.count * ICSSMExampleBenchmarkRepeatCount;
+    
+    NSString *keyTablePath = [bundle pathForResource:@"Benchmark" ofType:@"stylekeys"];
+    unsigned long long keyTableSize = [[[NSFileManager defaultManager] attributesOfItemAtPath:keyTablePath error:NULL] fileSize];
+    
+    NSLog(@"Benchmark of %lu reads of %lu keys: dictionary %.1f ns/read, key table %.1f ns/read (%llu bytes)",
+          (unsigned long)readCount, (unsigned long)keys.count,
+          dictionaryTime * 1e9 / readCount, keyTableTime * 1e9 / readCount, keyTableSize);
+}
+
+#endif
+
+
 @implementation ICSSMExampleAppDelegate
 
 - (BOOL)application:(UIApplication *)application didFinishLaunchingWithOptions:(NSDictionary *)launchOptions {
-    // load the style file `Example.style` bundled within the app; since this is the first
-    // time we call [ICSStyleManager sharedManager], the shared manager will be automatically created
+#if defined(ICS_STYLE_MANAGER_BENCHMARK)
+    // define ICS_STYLE_MANAGER_BENCHMARK to compare the lookups through the key table
+    // with the ones through the regular storage
+    ICSSMExampleRunKeyTableBenchmark();
+#endif
+    
+    // pass the screen width to the style as an environment value, so that it can be referred
+    // to as `@$screenWidth`; since this is the first time we call [ICSStyleManager sharedManager],
+    // the shared manager will be automatically created
+    [[ICSStyleManager sharedManager] setEnvironmentValue:CGRectGetWidth([[UIScreen mainScreen] bounds]) forName:@"screenWidth"];
+    
+    // load the style file `Example.style` bundled within the app
     [[ICSStyleManager sharedManager] loadStyle:@"Example"];
     
     // load the style file `Override-Example.style` bundled within the app, that will override
     // a value previosly defined by `Example.style`
     [[ICSStyleManager sharedManager] loadStyle:@"Override-Example"];
     
+    // load the key table `Example.stylekeys`, written by the Run Script build phase of the
+    // example target with all the keys of the two styles above, so that each of their keys
+    // is found with a single string comparison
+    [[ICSStyleManager sharedManager] loadKeyTable:@"Example" fromBundle:[NSBundle mainBundle]];
+    
 
     self.window = [[UIWindow alloc] initWithFrame:[[UIScreen mainScreen] bounds]];
     // obtain window's background color from the loaded style
@@ -10,28 +10,67 @@
 #import "ICSStyleManager.h"
 
 
+// style values used by the cell, filled by a single ICSStyleValueBatch call
+typedef struct {
+    __unsafe_unretained UIFont *textFont;
+    __unsafe_unretained UIColor *normalTextColor;
+    __unsafe_unretained UIColor *highlightedTextColor;
+    __unsafe_unretained UIImage *normalImage;
+    __unsafe_unretained UIImage *highlightedImage;
+    CGFloat buttonMargin;
+} ICSSMExampleResizableImageCellStyle;
+
+static const ICSStyleValueRequest ICSSMExampleResizableImageCellStyleRequests[] = {
+    { @"tableView.resizableImageCell.button.text.font", ICSStyleValueTypeFont, offsetof(ICSSMExampleResizableImageCellStyle, textFont) },
+    { @"tableView.resizableImageCell.button.text.color.normal", ICSStyleValueTypeColor, offsetof(ICSSMExampleResizableImageCellStyle, normalTextColor) },
+    { @"tableView.resizableImageCell.button.text.color.highlighted", ICSStyleValueTypeColor, offsetof(ICSSMExampleResizableImageCellStyle, highlightedTextColor) },
+    { @"tableView.resizableImageCell.button.image.normal", ICSStyleValueTypeImage, offsetof(ICSSMExampleResizableImageCellStyle, normalImage) },
+    { @"tableView.resizableImageCell.button.image.highlighted", ICSStyleValueTypeImage, offsetof(ICSSMExampleResizableImageCellStyle, highlightedImage) },
+    { @"tableView.resizableImageCell.button.margin", ICSStyleValueTypeFloat, offsetof(ICSSMExampleResizableImageCellStyle, buttonMargin) }
+};
+
+
 @interface ICSSMExampleResizableImageCell ()
 
 @property (nonatomic, readonly) UIButton *button;
+@property (nonatomic, readonly) CGFloat buttonMargin;
 
 @end
 
 
 @implementation ICSSMExampleResizableImageCell
 
++ (ICSStyleValueBatch *)styleBatch {
+    // the batch is created (and its keys checked) only once, then shared by all the cells
+    static ICSStyleValueBatch *styleBatch = nil;
+    
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        styleBatch = [[ICSStyleManager sharedManager] valueBatchWithRequests:ICSSMExampleResizableImageCellStyleRequests
+                                                                       count:sizeof(ICSSMExampleResizableImageCellStyleRequests) / sizeof(ICSSMExampleResizableImageCellStyleRequests[0])];
+    });
+    
+    return styleBatch;
+}
+
 - (id)initWithReuseIdentifier:(NSString *)reuseIdentifier {
     if ((self = [super initWithStyle:UITableViewCellStyleDefault reuseIdentifier:reuseIdentifier])) {
+        ICSSMExampleResizableImageCellStyle style;
+        [[[self class] styleBatch] getValues:&style];
+        
+        _buttonMargin = style.buttonMargin;
+        
         _button = [UIButton buttonWithType:UIButtonTypeCustom];
         [_button setTitle:NSLocalizedString(@"Example Button", @"") forState:UIControlStateNormal];
-        _button.titleLabel.font = [[ICSStyleManager sharedManager] fontForKey:@"tableView.resizableImageCell.button.text.font"];
+        _button.titleLabel.font = style.textFont;
         
         // set (resizable) background image and text color for the normal button state
-        [_button setTitleColor:[[ICSStyleManager sharedManager] colorForKey:@"tableView.resizableImageCell.button.text.color.normal"] forState:UIControlStateNormal];
-        [_button setBackgroundImage:[[ICSStyleManager sharedManager] imageForKey:@"tableView.resizableImageCell.button.image.normal"] forState:UIControlStateNormal];
+        [_button setTitleColor:style.normalTextColor forState:UIControlStateNormal];
+        [_button setBackgroundImage:style.normalImage forState:UIControlStateNormal];
         
         // set (resizable) background image and text color for the highlighted button state
-        [_button setTitleColor:[[ICSStyleManager sharedManager] colorForKey:@"tableView.resizableImageCell.button.text.color.highlighted"] forState:UIControlStateHighlighted];
-        [_button setBackgroundImage:[[ICSStyleManager sharedManager] imageForKey:@"tableView.resizableImageCell.button.image.highlighted"] forState:UIControlStateHighlighted];
+        [_button setTitleColor:style.highlightedTextColor forState:UIControlStateHighlighted];
+        [_button setBackgroundImage:style.highlightedImage forState:UIControlStateHighlighted];
         
         [_button addTarget:self action:@selector(tap) forControlEvents:UIControlEventTouchUpInside];
         
@@ -48,7 +87,7 @@
 - (void)layoutSubviews {
     [super layoutSubviews];
     
-    const CGFloat kButtonMargin = [[ICSStyleManager sharedManager] floatForKey:@"tableView.resizableImageCell.button.margin"];
+    const CGFloat kButtonMargin = self.buttonMargin;
     self.button.frame = CGRectMake(kButtonMargin, kButtonMargin,
                                    self.bounds.size.width - (2.0f * kButtonMargin),
                                    self.bounds.size.height - (2.0f * kButtonMargin));
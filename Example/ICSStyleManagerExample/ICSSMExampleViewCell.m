@@ -10,6 +10,28 @@
 #import "ICSStyleManager.h"
 
 
+// style values used by the cell, filled by a single ICSStyleValueBatch call
+typedef struct {
+    __unsafe_unretained UIColor *square1Color;
+    __unsafe_unretained UIColor *square2Color;
+    CGPoint square1Position;
+    CGPoint square2Position;
+    CGFloat square1Width;
+    CGFloat square2Width;
+    CGFloat squareHeight;
+} ICSSMExampleViewCellStyle;
+
+static const ICSStyleValueRequest ICSSMExampleViewCellStyleRequests[] = {
+    { @"tableView.viewCell.square1.color", ICSStyleValueTypeColor, offsetof(ICSSMExampleViewCellStyle, square1Color) },
+    { @"tableView.viewCell.square2.color", ICSStyleValueTypeColor, offsetof(ICSSMExampleViewCellStyle, square2Color) },
+    { @"tableView.viewCell.square1.position", ICSStyleValueTypePoint, offsetof(ICSSMExampleViewCellStyle, square1Position) },
+    { @"tableView.viewCell.square2.position", ICSStyleValueTypePoint, offsetof(ICSSMExampleViewCellStyle, square2Position) },
+    { @"tableView.viewCell.square1.width", ICSStyleValueTypeFloat, offsetof(ICSSMExampleViewCellStyle, square1Width) },
+    { @"tableView.viewCell.square2.width", ICSStyleValueTypeFloat, offsetof(ICSSMExampleViewCellStyle, square2Width) },
+    { @"tableView.viewCell.squareHeight", ICSStyleValueTypeFloat, offsetof(ICSSMExampleViewCellStyle, squareHeight) }
+};
+
+
 @interface ICSSMExampleViewCell ()
 
 @property (nonatomic, readonly) UIView *square1View;
@@ -20,24 +42,34 @@
 
 @implementation ICSSMExampleViewCell
 
++ (ICSStyleValueBatch *)styleBatch {
+    // the batch is created (and its keys checked) only once, then shared by all the cells
+    static ICSStyleValueBatch *styleBatch = nil;
+    
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        styleBatch = [[ICSStyleManager sharedManager] valueBatchWithRequests:ICSSMExampleViewCellStyleRequests
+                                                                       count:sizeof(ICSSMExampleViewCellStyleRequests) / sizeof(ICSSMExampleViewCellStyleRequests[0])];
+    });
+    
+    return styleBatch;
+}
+
 - (id)initWithReuseIdentifier:(NSString *)reuseIdentifier {
     if ((self = [super initWithStyle:UITableViewCellStyleDefault reuseIdentifier:reuseIdentifier])) {
+        ICSSMExampleViewCellStyle style;
+        [[[self class] styleBatch] getValues:&style];
+        
         _square1View = [[UIView alloc] init];
-        _square1View.backgroundColor = [[ICSStyleManager sharedManager] colorForKey:@"tableView.viewCell.square1.color"];
+        _square1View.backgroundColor = style.square1Color;
         [self addSubview:_square1View];
         
         _square2View = [[UIView alloc] init];
-        _square2View.backgroundColor = [[ICSStyleManager sharedManager] colorForKey:@"tableView.viewCell.square2.color"];
+        _square2View.backgroundColor = style.square2Color;
         [self addSubview:_square2View];
         
-        const CGPoint kSquare1Position = [[ICSStyleManager sharedManager] pointForKey:@"tableView.viewCell.square1.position"];
-        const CGPoint kSquare2Position = [[ICSStyleManager sharedManager] pointForKey:@"tableView.viewCell.square2.position"];
-        const CGFloat kSquare1Width = [[ICSStyleManager sharedManager] floatForKey:@"tableView.viewCell.square1.width"];
-        const CGFloat kSquare2Width = [[ICSStyleManager sharedManager] floatForKey:@"tableView.viewCell.square2.width"];
-        const CGFloat kSquareHeight = [[ICSStyleManager sharedManager] floatForKey:@"tableView.viewCell.squareHeight"];
-        
-        _square1View.frame = CGRectMake(kSquare1Position.x, kSquare1Position.y, kSquare1Width, kSquareHeight);
-        _square2View.frame = CGRectMake(kSquare2Position.x, kSquare2Position.y, kSquare2Width, kSquareHeight);
+        _square1View.frame = CGRectMake(style.square1Position.x, style.square1Position.y, style.square1Width, style.squareHeight);
+        _square2View.frame = CGRectMake(style.square2Position.x, style.square2Position.y, style.square2Width, style.squareHeight);
     }
     
     return self;
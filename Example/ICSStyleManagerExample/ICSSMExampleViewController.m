@@ -41,6 +41,13 @@ typedef NS_ENUM(NSUInteger, ICSSMExampleSection) {
     self.navigationItem.rightBarButtonItem = doneButton;
 }
 
+- (void)viewWillTransitionToSize:(CGSize)size withTransitionCoordinator:(id<UIViewControllerTransitionCoordinator>)coordinator {
+    [super viewWillTransitionToSize:size withTransitionCoordinator:coordinator];
+    
+    // only the style values depending on `@$screenWidth` are evaluated again
+    [[ICSStyleManager sharedManager] setEnvironmentValue:size.width forName:@"screenWidth"];
+}
+
 #pragma mark - Table View Data Source
 
 - (NSInteger)numberOfSectionsInTableView:(UITableView *)tableView {
@@ -29,6 +29,81 @@
 
 
 @protocol ICSStyleManagerImageLoader;
+@class ICSStyleValueBatch;
+
+
+/**
+ Struct that reports the memory used by the styles loaded into
+ an `ICSStyleManager`, expressed in bytes.
+ */
+typedef struct {
+    /** Memory used by the strings of the keys. */
+    size_t keys;
+    /** Memory used by the numeric values. */
+    size_t numbers;
+    /** Memory used by the rect, size and point values. */
+    size_t geometricValues;
+    /** Memory used by the color values. */
+    size_t colors;
+    /** Memory used by the font values. */
+    size_t fonts;
+    /** Memory used by the image values, including the images
+        retained by pattern image colors. */
+    size_t images;
+    /** Memory used by the tables mapping keys to values,
+        including the key table and the font caches. */
+    size_t storage;
+    /** Sum of all the other fields. */
+    size_t total;
+} ICSStyleFootprint;
+
+
+/**
+ Types of the values that can be requested to an
+ ICSStyleValueBatch, each one matching the `ICSStyleManager`'s
+ getter method with the same name.
+ */
+typedef NS_ENUM(NSUInteger, ICSStyleValueType) {
+    /** A `CGFloat` value, as returned by floatForKey:. */
+    ICSStyleValueTypeFloat,
+    /** An `NSInteger` value, as returned by integerForKey:. */
+    ICSStyleValueTypeInteger,
+    /** An `NSUInteger` value, as returned by unsignedIntegerForKey:. */
+    ICSStyleValueTypeUnsignedInteger,
+    /** An `NSTimeInterval` value, as returned by timeIntervalForKey:. */
+    ICSStyleValueTypeTimeInterval,
+    /** A `CGRect` value, as returned by rectForKey:. */
+    ICSStyleValueTypeRect,
+    /** A `CGSize` value, as returned by sizeForKey:. */
+    ICSStyleValueTypeSize,
+    /** A `CGPoint` value, as returned by pointForKey:. */
+    ICSStyleValueTypePoint,
+    /** A `UIFont` value, as returned by fontForKey:. */
+    ICSStyleValueTypeFont,
+    /** A `UIColor` value, as returned by colorForKey:. */
+    ICSStyleValueTypeColor,
+    /** A `UIImage` value, as returned by imageForKey:. */
+    ICSStyleValueTypeImage
+};
+
+
+/**
+ Struct that describes a value requested to an ICSStyleValueBatch:
+ the key of the value, its type and the offset (as computed by
+ `offsetof()`) of the field of the caller's struct that the value
+ will be copied into.
+ 
+ Object values are copied into fields declared as
+ `__unsafe_unretained`, since they are kept alive by the batch.
+ */
+typedef struct {
+    /** The key of the requested value. */
+    __unsafe_unretained NSString *key;
+    /** The type of the requested value. */
+    ICSStyleValueType type;
+    /** The offset of the field the value is copied into. */
+    size_t offset;
+} ICSStyleValueRequest;
 
 
 /**
@@ -140,6 +215,12 @@
     `Subheadline`, `Body`, `Footnote`, `Caption1` or `Caption2`
     (for example, `FONT (Headline)`).
  
+ Keys assigned the same font name and size share a single `UIFont`
+ instance. Keys assigned a preferred font are updated automatically
+ when the user changes the preferred content size category, so that
+ fontForKey: always returns a font matching the current Dynamic Type
+ setting (values already returned by fontForKey: are not changed).
+ 
  #### Color Values
  
  Color (i.e. `UIColor`) values can be defined in a *style file* with
@@ -218,6 +299,10 @@
     and will construct the UIImage value through
     `--[UIImage resizableImageWithCapInsets:]`.
  
+ Images can also be loaded and decoded ahead of time on a background
+ queue with prefetchImagesForKey:completion:, so that they aren't
+ decoded on the main thread when they are first displayed.
+ 
  #### <a id="numerical-expressions"></a> Numerical Expressions
  
  `ICSStyleManager` uses 
@@ -230,6 +315,13 @@
  For example, `floor(5 / 2)` is a valid numerical expression that can
  be used in a *style file*.
  
+ Numerical expressions whose inputs are all constants can be
+ replaced with their values at build time by the
+ `Tools/fold_style.py` script, so that the bundled *style files*
+ don't need to evaluate them when loaded; values written as plain
+ numbers (e.g. `#(40)`) are read without going through
+ `DDMathParser`.
+ 
  #### Groups of Values
  
  A style can define a group of semantically related values to be
@@ -301,8 +393,65 @@
     }
  
     defaultMargin = #(@view.width - 50)
- 
- 
+
+ #### <a id="environment-values"></a> Environment Values
+
+ Values that are only known at runtime (e.g. the width of the screen
+ or the safe area insets) can be passed to `ICSStyleManager` as
+ *environment values* with setEnvironmentValue:forName: or
+ setEnvironmentValues:, and then referred to in a *style file* by
+ prefixing their name with `@$`, both in assignments and in
+ [numerical expressions](#numerical-expressions):
+
+    [[ICSStyleManager sharedManager] setEnvironmentValue:CGRectGetWidth([UIScreen mainScreen].bounds)
+                                                 forName:@"screenWidth"];
+
+ with the *style file*:
+
+    view {
+        width = #(@$screenWidth - 40)
+        frame = R(20, 20, @view.width, 100)
+    }
+
+ When an environment value changes (e.g. on rotation), only the
+ values depending on it, either directly or through other variables,
+ are evaluated again, without loading the *style file* again. In the
+ example above, both `view.width` and `view.frame` are evaluated
+ again when `screenWidth` changes. The other variables keep the
+ values they had where the assignment appears in the *style file*,
+ even if their keys are assigned again afterwards (e.g. by a style
+ loaded later).
+
+ <div class="warning"> <strong>Warning:</strong> Environment values
+ must be set before loading a style that refers to them.</div>
+
+ #### <a id="imports"></a> Importing Other Styles
+
+ Values shared by several *style files* (e.g. a common palette or
+ spacing) can be defined once in a separate *style file* and imported
+ by writing:
+
+    @import "palette"
+
+ The imported *style file* is looked up in the same way as the ones
+ passed to loadStyle:fromBundle:, thus the `.style` extension must
+ be omitted. All the values defined by the imported style are assigned
+ at the point of the `@import` directive, so that they override the
+ values previously assigned in the importing *style file* and they
+ can be overridden (or referred to as [variables](#variables)) by the
+ following assignments.
+
+ Each imported *style file* is parsed only once by the same
+ `ICSStyleManager` instance, then its values are shared by all the
+ styles importing it. For this reason, an imported *style file* must
+ be self-contained: its variables can only refer to keys defined in
+ the file itself or in the styles it imports.
+
+ <div class="warning"> <strong>Warning:</strong> The <code>@import</code>
+ directive can't be placed inside a group of values, and a style can't
+ import itself, neither directly nor through other imported styles.</div>
+
+
  ### Overriding Values in Another Style
  
  `ICSStyleManager` supports loading more than one style with multiple
@@ -423,6 +572,126 @@
 */
 - (void)loadStyle:(NSString *)styleName fromBundle:(NSBundle *)bundle;
 
+/** @name Loading Styles with an Access Profile */
+
+/**
+ Starts recording the keys whose values are read from the style
+ manager, in the order they are read for the first time. Call
+ it right after loading the styles at launch, then call
+ stopRecordingAccessProfileAndWriteToFile: once the first
+ screen has been displayed.
+ 
+ @see stopRecordingAccessProfileAndWriteToFile:
+ */
+- (void)startRecordingAccessProfile;
+
+/**
+ Stops recording the keys whose values are read from the style
+ manager, and writes them to a property list file as an array
+ of strings (the *access profile*).
+ 
+ @param path Path of the file the access profile is written to.
+ 
+ @return `YES` if the access profile has been written
+         successfully, `NO` otherwise.
+ 
+ @see loadStyle:fromBundle:withAccessProfileAtPath:
+ */
+- (BOOL)stopRecordingAccessProfileAndWriteToFile:(NSString *)path;
+
+/**
+ Loads a style like loadStyle:fromBundle:, but evaluates right
+ away only the values of the keys listed in an access profile
+ recorded with startRecordingAccessProfile, along with the values
+ they refer to through [variables](#variables) and the styles
+ [imported](#imports) by the style. All the other values are
+ evaluated on a background queue; reading one of them before it
+ has been evaluated evaluates it (and the values it refers to) on
+ the reading thread, instead of waiting for the background queue.
+ 
+ While the style is being evaluated on the background queue, the
+ image loader may be asked for images from that queue, and it may
+ read values of the style from there. It must not wait for another
+ thread reading values of the style (e.g. by synchronously
+ dispatching to the main queue), since that thread may be waiting
+ for the image being loaded.
+ 
+ Changing [environment values](#environment-values), a change of
+ the preferred content size category and prefetchImagesForKey:completion:
+ are postponed until the evaluation finishes, without blocking the
+ calling thread: values read in the meantime don't reflect them
+ yet. Loading another style, compacting the style manager or
+ measuring its footprint wait for the evaluation to finish instead,
+ so styles overriding the profiled one should be loaded along with
+ it with loadStyles:fromBundle:withAccessProfileAtPath:.
+ 
+ If there is no access profile at the given path, the whole
+ style is loaded right away.
+ 
+ @param styleName         The name of the style to be loaded,
+                          looked up as in loadStyle:fromBundle:.
+ @param bundle            Custom bundle where *styleName* file
+                          is located.
+ @param accessProfilePath Path of the access profile written by
+                          stopRecordingAccessProfileAndWriteToFile:.
+ */
+- (void)loadStyle:(NSString *)styleName fromBundle:(NSBundle *)bundle withAccessProfileAtPath:(NSString *)accessProfilePath;
+
+/**
+ Loads several styles like loadStyle:fromBundle:withAccessProfileAtPath:,
+ as if they were a single style made of all of them in the given
+ order. This is meant for a base style and the styles overriding
+ it, which are evaluated together on the background queue:
+ 
+    [styleManager loadStyles:@[@"Style", @"Override-Style"]
+                  fromBundle:[NSBundle mainBundle]
+     withAccessProfileAtPath:accessProfilePath];
+ 
+ If there is no access profile at the given path, the styles are
+ loaded right away, one after the other.
+ 
+ @param styleNames        The names of the styles to be loaded,
+                          looked up as in loadStyle:fromBundle:.
+ @param bundle            Custom bundle where the style files
+                          are located.
+ @param accessProfilePath Path of the access profile written by
+                          stopRecordingAccessProfileAndWriteToFile:,
+                          recorded while the same styles were loaded.
+ */
+- (void)loadStyles:(NSArray *)styleNames fromBundle:(NSBundle *)bundle withAccessProfileAtPath:(NSString *)accessProfilePath;
+
+/** @name Managing Environment Values */
+
+/**
+ Sets the value of an [environment value](#environment-values),
+ that can be referred to in a *style file* as `@$name`. The
+ values depending on it in the loaded styles are evaluated again.
+ 
+ @param value The new value.
+ @param name  The name of the environment value, without the
+              `$` prefix.
+ 
+ @see setEnvironmentValues:
+ */
+- (void)setEnvironmentValue:(CGFloat)value forName:(NSString *)name;
+
+
+/**
+ Sets the values of several [environment values](#environment-values)
+ at once. Use this method when more than one environment value
+ changes at the same time (e.g. screen width and safe area insets
+ on rotation), so that the values depending on more than one of
+ them are evaluated again only once.
+ 
+ @param environmentValues A dictionary mapping the names of the
+                          environment values (without the `$`
+                          prefix) to `NSNumber` values.
+ 
+ @see setEnvironmentValue:forName:
+ */
+- (void)setEnvironmentValues:(NSDictionary *)environmentValues;
+
+
 /** @name Getting Style Values */
 
 /**
@@ -540,7 +809,9 @@
             loadStyle:.
  
  @return    The unsigned integer value associated with the
-            specified key.
+            specified key, truncated toward zero. Negative
+            values and NaN are returned as 0, values too large
+            as `NSUIntegerMax`.
  
  @see       integerForKey:
  @see       loadStyle:
@@ -555,7 +826,9 @@
             loadStyle:.
  
  @return    The integer value associated with the specified
-            key.
+            key, truncated toward zero. NaN is returned as 0,
+            values out of range as `NSIntegerMin` or
+            `NSIntegerMax`.
  
  @see       unsignedIntegerForKey:
  @see       loadStyle:
@@ -578,6 +851,188 @@
 - (NSTimeInterval)timeIntervalForKey:(NSString *)key;
 
 
+/** @name Getting Batches of Style Values */
+
+/**
+ Returns a batch that resolves all the given values at once and
+ copies them into a caller-provided C struct with a single call
+ to -[ICSStyleValueBatch getValues:]. This is meant to configure
+ views that need several style values (e.g. table view cells)
+ without paying for a separate lookup of each value:
+ 
+    typedef struct {
+        __unsafe_unretained UIColor *color;
+        CGFloat height;
+    } ExampleCellStyle;
+ 
+    static const ICSStyleValueRequest ExampleCellStyleRequests[] = {
+        { @"cell.color", ICSStyleValueTypeColor, offsetof(ExampleCellStyle, color) },
+        { @"cell.height", ICSStyleValueTypeFloat, offsetof(ExampleCellStyle, height) }
+    };
+ 
+    ICSStyleValueBatch *batch = [[ICSStyleManager sharedManager] valueBatchWithRequests:ExampleCellStyleRequests
+                                                                                  count:2];
+    ExampleCellStyle style;
+    [batch getValues:&style];
+ 
+ All the requested keys are checked against the loaded style as
+ soon as the batch is created, and the batch is meant to be
+ created once and then reused (e.g. by keeping it in a static
+ variable).
+ 
+ @param requests The requested values. The array is copied, so
+                 it doesn't need to outlive the method call.
+ @param count    The number of elements of *requests*.
+ 
+ @return A batch resolving the requested values.
+ */
+- (ICSStyleValueBatch *)valueBatchWithRequests:(const ICSStyleValueRequest *)requests count:(NSUInteger)count;
+
+
+/** @name Finding Unread Keys */
+
+/**
+ Starts tracking the keys whose values are read from the style
+ manager, so that the keys that are never read during a session
+ can be reported by unreadKeys.
+ 
+ @see writeUnreadKeysToFile:
+ */
+- (void)startTrackingReadKeys;
+
+/**
+ Returns the keys defined by the loaded styles whose values
+ haven't been read since startTrackingReadKeys has been called.
+ 
+ @return The unread keys, sorted alphabetically, or `nil` if
+         startTrackingReadKeys hasn't been called.
+ */
+- (NSArray *)unreadKeys;
+
+/**
+ Writes the keys returned by unreadKeys to a text file, one key
+ per line. The files written at the end of several sessions can
+ be passed, along with a *style file*, to the
+ `Tools/prune_style.py` script, which writes a copy of the style
+ without the keys that have never been read in any session
+ (keeping the ones the read keys refer to through
+ [variables](#variables)).
+ 
+ @param path Path of the file the unread keys are written to.
+ 
+ @return `YES` if the file has been written successfully, `NO`
+         otherwise (including when startTrackingReadKeys hasn't
+         been called, in which case no file is written).
+ */
+- (BOOL)writeUnreadKeysToFile:(NSString *)path;
+
+
+/** @name Using a Key Table */
+
+/**
+ Loads a *key table* for the keys defined by a set of styles
+ (typically a style and the styles overriding it) and by the
+ styles they [import](#imports), which is then used to look up
+ the keys it contains whenever a value is read. A key table is a
+ minimal perfect hash table mapping each key to a distinct slot,
+ so that the value of a key it contains is found with a single
+ string comparison.
+ 
+ Key tables are written at build time by the
+ `Tools/generate_key_table.py` script to a file with the
+ `.stylekeys` extension, bundled along with the style files
+ (e.g. by a Run Script build phase).
+ 
+ Keys that are not part of the table are still looked up as
+ usual, so a stale key table never causes wrong values to be
+ returned.
+ 
+ @param keyTableName The name of the key table to be loaded. The
+                     `.stylekeys` extension will be appended to
+                     the name.
+ @param bundle       Custom bundle where *keyTableName* file is
+                     located. In case it is not found inside the
+                     given bundle, the manager will attempt to load
+                     it from the app's main Bundle Resources.
+ */
+- (void)loadKeyTable:(NSString *)keyTableName fromBundle:(NSBundle *)bundle;
+
+
+/** @name Prefetching Images */
+
+/**
+ Loads and decodes on a background queue the images referred to
+ by the value of a key, or by the values of all the keys of a
+ group of values (e.g. `tableView.resizableImageCell`), including
+ the images of pattern image colors. At most two images are
+ decoded at the same time.
+ 
+ Decoded images keep the rendering mode, slicing and alignment
+ insets of the loaded ones, and are decoded in a wide color
+ format on screens supporting it (on iOS 10 and later; on earlier
+ versions images are only loaded ahead of time). The images
+ shared by the image loader, and their assets, are left untouched:
+ decoded images are only returned by the style manager, resolved
+ for the traits of the screen at the time they are prefetched.
+ 
+ Once prefetched, an image is returned by imageForKey: with its
+ cap insets already applied, without being loaded again, and a
+ pattern image color is replaced by a color using the decoded
+ image. Prefetched images are kept in memory as long as the
+ values referring to them. Once all the images have been
+ prefetched, [value batches](ICSStyleValueBatch) resolve their
+ values again, so that they copy the decoded images.
+ 
+ This method must be called on the main thread, and the image
+ loader may be asked for images from the background queue.
+ 
+ @param key        The key of the value, or the group of values,
+                   whose images are prefetched.
+ @param completion Block called on the main queue once all the
+                   images have been prefetched. It can be `nil`.
+ */
+- (void)prefetchImagesForKey:(NSString *)key completion:(void (^)(void))completion;
+
+
+/** @name Managing Memory */
+
+/**
+ Returns a report of the memory used by the loaded styles.
+ 
+ Objects shared by more than one key (e.g. through
+ variables) are only counted once. The sizes
+ of fonts and colors only account for the objects themselves,
+ while the images retained by pattern image colors still
+ assigned to a key account for their decoded bitmaps. The values
+ kept for the styles importing an [imported](#imports) style,
+ the cached fonts and the key table, if any, are counted as well.
+ 
+ @return The memory used by the loaded styles, broken down by
+         kind of value.
+ 
+ @see    compact
+ */
+- (ICSStyleFootprint)footprint;
+
+
+/**
+ Rebuilds the storage of the loaded styles into a dense form,
+ where the group prefixes and names of the keys are shared
+ among all the values and numeric, rect, size and point values
+ are kept unboxed.
+ 
+ The method is meant to be called once all the styles have been
+ loaded: loading another style with loadStyle: rebuilds the
+ regular storage first, and the method must then be called again
+ to compact the style. The values of the [imported](#imports)
+ styles are kept as they are, so that each imported *style file*
+ is still parsed only once.
+ 
+ @see footprint
+ */
+- (void)compact;
+
+
 /** @name Managing the Image Loader */
 
 /**
@@ -621,3 +1076,31 @@
 - (UIImage *)styleManager:(ICSStyleManager *)styleManager imageNamed:(NSString *)imageName;
 
 @end
+
+
+/**
+ The `ICSStyleValueBatch` class copies a precompiled list of
+ style values into a caller-provided C struct with a single
+ call. Batches are created by
+ -[ICSStyleManager valueBatchWithRequests:count:].
+ 
+ The requested values are resolved once and kept by the batch,
+ which resolves them again only after the style manager loads
+ another style or finishes prefetching images.
+ */
+@interface ICSStyleValueBatch : NSObject
+
+/**
+ Copies the requested values into the fields of the given
+ struct.
+ 
+ Object values copied into the struct are retained by the
+ batch, and stay valid until the batch resolves its values
+ again after another style has been loaded.
+ 
+ @param values A pointer to the struct the values are copied
+               into.
+ */
+- (void)getValues:(void *)values;
+
+@end
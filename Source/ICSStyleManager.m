@@ -29,6 +29,7 @@
 #import "NSRegularExpression+ICSRegEx.h"
 #import "UIColor+ICSRGB.h"
 #import "NSString+DDMathParsing.h"
+#import <malloc/malloc.h>
 
 
 // -------------------------
@@ -39,6 +40,10 @@
 // string passed to -loadFile:)
 static NSString *const STOStyleFileExtension = @"style";
 
+// Extension of the key table files (will automatically be added to the
+// string passed to -loadKeyTable:fromBundle:)
+static NSString *const STOStyleKeyTableFileExtension = @"stylekeys";
+
 // All the lines beginning with this prefix will be treated as comments
 static NSString *const STOStyleCommentPrefix = @"//";
 
@@ -48,6 +53,13 @@ static NSString *const STOStyleCommentPrefix = @"//";
 // to reflect the change.)
 static NSString *const STOStyleGroupSeparator = @".";
 
+// Prefix of the variables referring to environment values instead of keys
+// (e.g. `@$screenWidth`)
+static NSString *const STOStyleEnvironmentPrefix = @"$";
+
+// Maximum number of images decoded at the same time when prefetching images
+static const NSInteger STOStyleImagePrefetchConcurrency = 2;
+
 
 // -------------------------
 // Regular Expressions
@@ -56,12 +68,12 @@ static NSString *const STOStyleGroupSeparator = @".";
 // Pattern that matches a value assignment (e.g. `key = value`)
 static NSString *const STOStyleAssignmentPattern = @"\\A([\\w|\\d|\\.]*)\\s*=\\s*(.*)\\z";
 
-// Pattern that matches a variable name (e.g. `@varName`)
-static NSString *const STOStyleVariablePattern = @"\\A@([\\w|\\d|\\.]*)\\z";
+// Pattern that matches a variable name (e.g. `@varName` or `@$environmentName`)
+static NSString *const STOStyleVariablePattern = @"\\A@(\\$?[\\w|\\d|\\.]*)\\z";
 
-// Pattern that matches a variable name (e.g. `@varName`) as a substring
-// of a possibly longer string
-static NSString *const STOStyleInnerVariablePattern = @"@([\\w|\\d|\\.]*)";
+// Pattern that matches a variable name (e.g. `@varName` or `@$environmentName`)
+// as a substring of a possibly longer string
+static NSString *const STOStyleInnerVariablePattern = @"@(\\$?[\\w|\\d|\\.]*)";
 
 // Pattern that matches a number value (e.g. `#(10)`)
 static NSString *const STOStyleNumberPattern = @"\\A#\\s*\\((.*)\\)\\z";
@@ -105,6 +117,9 @@ static NSString *const STOStyleOpenGroupPattern = @"\\A([\\w|\\d|\\.]*)\\s*\\{\\
 // Pattern that matches the end of a group of values block (e.g. `}`)
 static NSString *const STOStyleCloseGroupPattern = @"\\A\\}\\z";
 
+// Pattern that matches the import of another style (e.g. `@import "palette"`)
+static NSString *const STOStyleImportPattern = @"\\A@import\\s+\"([\\w-.]*)\"\\z";
+
 
 // -------------------------
 // Styles for Preferred Font
@@ -128,22 +143,197 @@ static NSString *const STOStylePreferredFontStyleCaption2 = @"Caption2";
 // Declaration of NSString category used to evaluate a numerical expression written
 // as string into a NSNumber. The category is implemented at the bottom of this source file
 @interface NSString (ICSStyleManager)
-- (NSNumber *)sto_numberByEvaluatingStringWithStyleDescriptor:(NSDictionary *)styleDescriptor;
+- (NSNumber *)sto_numberByEvaluatingStringWithStyleDescriptor:(NSDictionary *)styleDescriptor environment:(NSDictionary *)environment;
 @end
 
 
+// Functions used to handle the numbers written as literals in a style file, the
+// conversion of numbers to integers and the variables used inside numerical
+// expressions. They are implemented at the bottom of this source file, along with
+// the NSString category
+static NSNumber *STOStyleNumberFromLiteral(NSString *string);
+static NSInteger STOStyleIntegerFromNumber(double number);
+static NSUInteger STOStyleUnsignedIntegerFromNumber(double number);
+static NSArray *STOStyleVariableNamesInString(NSString *string);
+
+
 // Declaration of a tiny class used to store the informations needed to defer the
 // loading of an image defined in a style file
 @interface ICSStyleImageDescriptor : NSObject
 @property (nonatomic, copy) NSString *name;
 @property (nonatomic, copy) NSValue *capInsets;
+// Decoded image with cap insets applied, set once the image has been prefetched
+@property (nonatomic, strong) UIImage *decodedImage;
+@end
+
+
+// Declaration of a tiny class used to keep track of an assignment whose value depends
+// on environment values (either directly or through other assignments), so that it
+// can be evaluated again when they change. Inputs hold the values its variables had
+// when it was evaluated, while dependencies map the variables referring to other
+// dynamic assignments to their records, whose new values replace the inputs
+@interface ICSStyleDynamicAssignment : NSObject
+@property (nonatomic, copy) NSString *key;
+@property (nonatomic, copy) NSString *value;
+@property (nonatomic, copy) NSSet *environmentNames;
+@property (nonatomic, assign) NSUInteger order;
+@property (nonatomic, strong) NSMutableDictionary *inputs;
+@property (nonatomic, copy) NSDictionary *dependencies;
+@end
+
+
+// Declaration of a tiny class used to hold a line of a style file that has been
+// scanned but not evaluated yet: either the assignment of a value to a key path
+// or the import of another style
+@interface ICSStyleAssignment : NSObject
+@property (nonatomic, copy) NSString *keyPath;
+@property (nonatomic, copy) NSString *value;
+@property (nonatomic, copy) NSString *importedStyleName;
+@end
+
+
+// Declaration of a tiny class used to synchronize the reads of the values of a
+// style with their evaluation on a background queue. The pending keys and the
+// finished flag are only accessed with the condition locked, which is only held
+// to publish values. Assignments are evaluated with the evaluation lock held
+// instead: it is recursive, since evaluating an assignment may call the image
+// loader, which may read values of the style being evaluated on the same thread
+@interface ICSStyleDeferredLoading : NSObject
+@property (nonatomic, readonly) NSCondition *condition;
+@property (nonatomic, readonly) NSRecursiveLock *evaluationLock;
+@property (nonatomic, readonly) NSMutableSet *pendingKeys;
+@property (nonatomic, copy) void (^evaluatePendingKey)(NSString *key);
+// Operations postponed until the evaluation finishes, only accessed on the main thread
+@property (nonatomic, readonly) NSMutableArray *postponedOperations;
+@property (nonatomic, assign) BOOL finished;
+@end
+
+
+// Types of the values stored by ICSStyleCompactDescriptor: numeric and geometric
+// values are stored unboxed, while all the other values are stored as objects
+typedef NS_ENUM(uint8_t, STOStyleCompactValueType) {
+    STOStyleCompactValueTypeNumber,
+    STOStyleCompactValueTypePoint,
+    STOStyleCompactValueTypeSize,
+    STOStyleCompactValueTypeRect,
+    STOStyleCompactValueTypeObject
+};
+
+
+// Declaration of a class used to store the values of the loaded styles in a dense
+// form once they have been compacted. The class is implemented at the bottom of
+// this source file
+@interface ICSStyleCompactDescriptor : NSObject
+- (instancetype)initWithStyleDescriptor:(NSDictionary *)styleDescriptor;
+- (NSMutableDictionary *)mutableStyleDescriptor;
+- (id)objectForKey:(NSString *)key;
+- (BOOL)getScalars:(double *)scalars ofType:(STOStyleCompactValueType)type forKey:(NSString *)key;
+- (BOOL)replaceObject:(id)object forKey:(NSString *)key;
+- (void)replaceObjectsUsingBlock:(id (^)(id object))block;
+- (void)enumerateObjectsUsingBlock:(void (^)(NSString *key, id object))block;
+- (NSArray *)allKeys;
+- (void)addToFootprint:(ICSStyleFootprint *)footprint countedObjects:(NSHashTable *)countedObjects;
+@end
+
+
+// Declaration of a class used to look up keys into a minimal perfect hash table
+// generated at build time, so that each key is found with a single string comparison.
+// The class is implemented at the bottom of this source file
+@interface ICSStyleKeyTable : NSObject
+- (instancetype)initWithData:(NSData *)data;
+- (NSUInteger)indexOfKey:(NSString *)key;
+- (void)addToFootprint:(ICSStyleFootprint *)footprint;
+@property (nonatomic, readonly) NSArray *keys;
+@end
+
+
+// Private initializer of ICSStyleValueBatch, used by ICSStyleManager to create
+// batches of values. The class is implemented at the bottom of this source file
+@interface ICSStyleValueBatch ()
+- (instancetype)initWithStyleManager:(ICSStyleManager *)styleManager requests:(const ICSStyleValueRequest *)requests count:(NSUInteger)count;
 @end
 
 
+// Replaces the objects of a dictionary for which the given block returns a non-nil
+// replacement. The function is implemented at the bottom of this source file
+static void STOStyleReplaceObjectsInDictionary(NSMutableDictionary *dictionary, id (^block)(id object));
+
+
+// Function used to force the decoding of an image, so that it doesn't need to be
+// decoded when it is first drawn. It is implemented at the bottom of this source file
+static UIImage *STOStyleDecodedImage(UIImage *image);
+
+
+// Functions used to measure the memory used by the loaded styles. They are
+// implemented at the bottom of this source file
+static size_t STOStyleObjectFootprint(id object);
+static size_t STOStyleImageFootprint(UIImage *image);
+static void STOStyleAddDictionaryToFootprint(NSDictionary *dictionary, ICSStyleFootprint *footprint, NSHashTable *countedObjects);
+static void STOStyleAddValueToFootprint(id value, ICSStyleFootprint *footprint, NSHashTable *countedObjects);
+
+
 @interface ICSStyleManager ()
 // This dictionary holds the mapping between style keys and actual values
 // as they are parsed
 @property (nonatomic, readonly) NSMutableDictionary *styleDescriptor;
+// This dictionary holds the evaluated values of each style imported with an
+// `@import` directive, keyed by the path of its style file, so that an imported
+// style is parsed only once and then shared by all the styles importing it
+@property (nonatomic, readonly) NSMutableDictionary *importedStyleDescriptors;
+// This dictionary holds the dynamic assignments of each imported style, keyed
+// by the path of its style file
+@property (nonatomic, readonly) NSMutableDictionary *importedDynamicAssignments;
+// This array is used as a stack to hold the paths of the style files being
+// parsed, in order to detect cyclic imports
+@property (nonatomic, readonly) NSMutableArray *parsingStylePaths;
+// This map table holds the images retained by pattern image colors, keyed by
+// image name, so that they can be accounted for in the style's footprint. Images
+// are held weakly: they are released along with the last color using them
+@property (nonatomic, readonly) NSMapTable *patternImages;
+// This map table holds the name of the image of each pattern image color, so
+// that the color can be replaced once its image has been prefetched
+@property (nonatomic, readonly) NSMapTable *patternImageColorNames;
+// This queue is used to load and decode the prefetched images
+@property (nonatomic, readonly) NSOperationQueue *imagePrefetchQueue;
+// Once the loaded styles have been compacted, this object holds their values
+// in place of styleDescriptor
+@property (nonatomic, strong) ICSStyleCompactDescriptor *compactStyleDescriptor;
+// This counter is incremented every time the values of the loaded styles change,
+// so that batches of values know when they need to be resolved again
+@property (nonatomic, assign) NSUInteger styleGeneration;
+// This dictionary holds the environment values that can be referred to by
+// variables prefixed with `$`
+@property (nonatomic, readonly) NSMutableDictionary *environment;
+// This dictionary maps the keys whose values depend on environment values to
+// the corresponding ICSStyleDynamicAssignment
+@property (nonatomic, readonly) NSMutableDictionary *dynamicAssignments;
+// This counter is used to keep dynamic assignments in the order they are loaded
+@property (nonatomic, assign) NSUInteger dynamicAssignmentCount;
+// This dictionary holds the fonts created with a name and a size, keyed by
+// an array with both, so that they are shared by all the keys using them
+@property (nonatomic, readonly) NSMutableDictionary *fonts;
+// This dictionary holds the preferred fonts, keyed by text style
+@property (nonatomic, readonly) NSMutableDictionary *preferredFonts;
+// This map table holds the text style of each preferred font that has been
+// assigned to a key, so that it can be replaced when the content size
+// category changes
+@property (nonatomic, readonly) NSMapTable *preferredFontTextStyles;
+// While an access profile is being recorded, this ordered set holds the keys
+// that have been read, in the order they have been read for the first time
+@property (nonatomic, strong) NSMutableOrderedSet *accessProfile;
+// While the keys being read are tracked, this set holds all the keys that have
+// been read, so that the ones never read can be reported
+@property (nonatomic, strong) NSMutableSet *readKeys;
+// While a style loaded with an access profile is being evaluated on a background
+// queue, this object is used to wait for the values that are still pending. It is
+// atomic, since it is read by any thread reading values and cleared on the main one
+@property (atomic, strong) ICSStyleDeferredLoading *deferredLoading;
+// Once a key table has been loaded, this object is used to look up the keys it
+// contains into keyTableValues, which holds their values in the same order. The
+// values are filled when first read after loading a style, then the single values
+// replaced afterwards are updated in place
+@property (nonatomic, strong) ICSStyleKeyTable *keyTable;
+@property (nonatomic, strong) NSMutableArray *keyTableValues;
 @end
 
 
@@ -173,11 +363,31 @@ static NSString *const STOStylePreferredFontStyleCaption2 = @"Caption2";
 - (instancetype)init {
     if ((self = [super init])) {
         _styleDescriptor = [[NSMutableDictionary alloc] init];
+        _importedStyleDescriptors = [[NSMutableDictionary alloc] init];
+        _importedDynamicAssignments = [[NSMutableDictionary alloc] init];
+        _parsingStylePaths = [[NSMutableArray alloc] init];
+        _patternImages = [NSMapTable strongToWeakObjectsMapTable];
+        _patternImageColorNames = [NSMapTable mapTableWithKeyOptions:(NSPointerFunctionsWeakMemory | NSPointerFunctionsObjectPointerPersonality)
+                                                        valueOptions:NSPointerFunctionsStrongMemory];
+        _imagePrefetchQueue = [[NSOperationQueue alloc] init];
+        _imagePrefetchQueue.maxConcurrentOperationCount = STOStyleImagePrefetchConcurrency;
+        _environment = [[NSMutableDictionary alloc] init];
+        _dynamicAssignments = [[NSMutableDictionary alloc] init];
+        _fonts = [[NSMutableDictionary alloc] init];
+        _preferredFonts = [[NSMutableDictionary alloc] init];
+        _preferredFontTextStyles = [NSMapTable mapTableWithKeyOptions:(NSPointerFunctionsWeakMemory | NSPointerFunctionsObjectPointerPersonality)
+                                                         valueOptions:NSPointerFunctionsStrongMemory];
+        
+        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(contentSizeCategoryDidChange:) name:UIContentSizeCategoryDidChangeNotification object:nil];
     }
     
     return self;
 }
 
+- (void)dealloc {
+    [[NSNotificationCenter defaultCenter] removeObserver:self name:UIContentSizeCategoryDidChangeNotification object:nil];
+}
+
 
 #pragma mark - Style Loading
 
@@ -189,36 +399,93 @@ static NSString *const STOStylePreferredFontStyleCaption2 = @"Caption2";
     NSParameterAssert(styleName);
     NSParameterAssert(bundle);
 
-    // add style file extension to the style name and load it from the
+    [self waitForDeferredLoading];
+    
+    // new values can only be added to the regular storage
+    [self expandCompactStyleDescriptor];
+    
+    NSString *stylePath = [self pathForStyle:styleName inBundle:bundle];
+    [self parseStyle:styleName atPath:stylePath fromBundle:bundle intoStyleDescriptor:self.styleDescriptor dynamicAssignments:self.dynamicAssignments];
+    self.keyTableValues = nil;
+    self.styleGeneration++;
+    
+#if defined(ICS_STYLE_MANAGER_LOG)
+    NSLog(@"[ICSStyleManager]: Style `%@` loaded:\n%@", styleName, self.styleDescriptor);
+#endif
+}
+
+- (NSString *)pathForStyle:(NSString *)styleName inBundle:(NSBundle *)bundle {
+    NSParameterAssert(styleName);
+    NSParameterAssert(bundle);
+    
+    // add style file extension to the style name and look for it in the
     // given bundle
     NSString *stylePath = [bundle pathForResource:styleName ofType:STOStyleFileExtension];
     
     if (stylePath == nil && bundle != [NSBundle mainBundle]) {
-        // try to load from main bundle explicitly
+        // try to find it in the main bundle explicitly
         stylePath = [[NSBundle mainBundle] pathForResource:styleName ofType:STOStyleFileExtension];
     }
     
+    return stylePath;
+}
+
+- (void)parseStyle:(NSString *)styleName atPath:(NSString *)stylePath fromBundle:(NSBundle *)bundle intoStyleDescriptor:(NSMutableDictionary *)styleDescriptor dynamicAssignments:(NSMutableDictionary *)dynamicAssignments {
+    NSParameterAssert(styleName);
+    NSParameterAssert(bundle);
+    NSParameterAssert(styleDescriptor);
+    NSParameterAssert(dynamicAssignments);
+    
+    NSArray *assignments = [self assignmentsOfStyle:styleName atPath:stylePath];
+    if (assignments == nil) {
+        return;
+    }
+    
+    [self.parsingStylePaths addObject:stylePath];
+    
+    // evaluate the assignments in the order they appear in the style file
+    for (ICSStyleAssignment *assignment in assignments) {
+        [self applyAssignment:assignment fromBundle:bundle withEvaluatedValue:nil toStyleDescriptor:styleDescriptor dynamicAssignments:dynamicAssignments];
+    }
+    
+    [self.parsingStylePaths removeLastObject];
+}
+
+// Scans the lines of a style file into an array of ICSStyleAssignment, without
+// evaluating any value
+- (NSArray *)assignmentsOfStyle:(NSString *)styleName atPath:(NSString *)stylePath {
+    NSString *styleText = [self textOfStyle:styleName atPath:stylePath];
+    return (styleText != nil ? [self assignmentsOfStyleText:styleText] : nil);
+}
+
+- (NSString *)textOfStyle:(NSString *)styleName atPath:(NSString *)stylePath {
+    NSParameterAssert(styleName);
+    
     // load the style file into an NSString
     NSError *error = nil;
-    NSString *styleText = [[NSString alloc] initWithContentsOfFile:stylePath encoding:NSUTF8StringEncoding error:&error];
+    NSString *styleText = (stylePath != nil ? [[NSString alloc] initWithContentsOfFile:stylePath encoding:NSUTF8StringEncoding error:&error] : nil);
 
     NSAssert(styleText != nil, @"[ICSStyleManager]: Error loading style `%@`: %@", styleName, error);
+    return styleText;
+}
+
+- (NSArray *)assignmentsOfStyleText:(NSString *)styleText {
+    NSParameterAssert(styleText);
     
-    // separate the style text file into lines
-    NSArray *styleTextLines = [styleText componentsSeparatedByCharactersInSet:[NSCharacterSet newlineCharacterSet]];
-    
-    NSParameterAssert(styleTextLines);
     NSCharacterSet *whitespaceSet = [NSCharacterSet whitespaceCharacterSet];
     
     // this array is used as a stack to hold the current group of values while
     // we are parsing the style (empty array means no group)
     NSMutableArray *groups = [[NSMutableArray alloc] init];
     
-    [styleTextLines enumerateObjectsUsingBlock:^(NSString *line, NSUInteger idx, BOOL *stop) {
+    NSMutableArray *assignments = [[NSMutableArray alloc] init];
+    
+    // separate the style text file into lines, whatever their line terminators
+    [styleText enumerateSubstringsInRange:NSMakeRange(0, styleText.length) options:NSStringEnumerationByLines usingBlock:^(NSString *styleTextLine, NSRange lineRange, NSRange enclosingRange, BOOL *stop) {
         // for each line of the style file
         
         // trim whitespaces
-        line = [line stringByTrimmingCharactersInSet:whitespaceSet];
+        NSString *line = [styleTextLine stringByTrimmingCharactersInSet:whitespaceSet];
         
         // check for empty or comment line
         if ([line isEqualToString:@""] || [line hasPrefix:STOStyleCommentPrefix]) {
@@ -226,6 +493,16 @@ static NSString *const STOStylePreferredFontStyleCaption2 = @"Caption2";
             return;
         }
         
+        // check for the import of another style (e.g. `@import "palette"`)
+        NSArray *importMatch = [NSRegularExpression ics_capturedSubstringsWithFirstMatchOfPattern:STOStyleImportPattern inString:line];
+        if (importMatch.count == 1) {
+            NSAssert(groups.count == 0, @"[ICSStyleManager]: Style `%@` can't be imported inside a group of values", importMatch[0]);
+            ICSStyleAssignment *assignment = [[ICSStyleAssignment alloc] init];
+            assignment.importedStyleName = importMatch[0];
+            [assignments addObject:assignment];
+            return;
+        }
+        
         // check for the beginning of a group of values (e.g. `groupName {`)
         NSArray *match = [NSRegularExpression ics_capturedSubstringsWithFirstMatchOfPattern:STOStyleOpenGroupPattern inString:line];
         if (match.count == 1) {
@@ -245,57 +522,180 @@ static NSString *const STOStylePreferredFontStyleCaption2 = @"Caption2";
         // assume this is the assigment of a value to a key
         NSArray *assignmentMatches = [NSRegularExpression ics_capturedSubstringsWithFirstMatchOfPattern:STOStyleAssignmentPattern inString:line];
         NSAssert(assignmentMatches.count == 2, @"[ICSStyleManager]: Unrecognized command `%@`", line);
+        if (assignmentMatches.count != 2) {
+            return;
+        }
+        
+        ICSStyleAssignment *assignment = [[ICSStyleAssignment alloc] init];
+        assignment.keyPath = [self keyPathForKey:assignmentMatches[0] withGroups:groups];
+        assignment.value = assignmentMatches[1];
         
-        // parse assignment
-        NSString *keyName = assignmentMatches[0];
-        NSString *value = assignmentMatches[1];
-        [self parseAssignmentOfValue:value toKey:keyName withGroups:groups];
+        [assignments addObject:assignment];
     }];
     
-#if defined(ICS_STYLE_MANAGER_LOG)
-    NSLog(@"[ICSStyleManager]: Style `%@` loaded:\n%@", styleName, self.styleDescriptor);
-#endif
+    return assignments;
+}
+
+// Evaluates an assignment (unless its value has already been evaluated) or an
+// import, returning the evaluated value
+- (id)applyAssignment:(ICSStyleAssignment *)assignment fromBundle:(NSBundle *)bundle withEvaluatedValue:(id)evaluatedValue toStyleDescriptor:(NSMutableDictionary *)styleDescriptor dynamicAssignments:(NSMutableDictionary *)dynamicAssignments {
+    NSParameterAssert(assignment);
+    
+    if (assignment.importedStyleName != nil) {
+        [self importStyle:assignment.importedStyleName fromBundle:bundle intoStyleDescriptor:styleDescriptor dynamicAssignments:dynamicAssignments];
+        return nil;
+    }
+    
+    if (evaluatedValue == nil) {
+        return [self parseAssignmentOfValue:assignment.value toKeyPath:assignment.keyPath inStyleDescriptor:styleDescriptor dynamicAssignments:dynamicAssignments];
+    }
+    
+    [self assignEvaluatedValue:evaluatedValue ofValue:assignment.value toKeyPath:assignment.keyPath inStyleDescriptor:styleDescriptor dynamicAssignments:dynamicAssignments];
+    return evaluatedValue;
+}
+
+- (void)importStyle:(NSString *)styleName fromBundle:(NSBundle *)bundle intoStyleDescriptor:(NSMutableDictionary *)styleDescriptor dynamicAssignments:(NSMutableDictionary *)dynamicAssignments {
+    NSParameterAssert(styleName);
+    NSParameterAssert(bundle);
+    NSParameterAssert(styleDescriptor);
+    NSParameterAssert(dynamicAssignments);
+    
+    NSString *stylePath = [self pathForImportedStyle:styleName inBundle:bundle];
+    if (stylePath == nil) {
+        return;
+    }
+    
+    NSDictionary *importedStyleDescriptor = self.importedStyleDescriptors[stylePath];
+    if (importedStyleDescriptor == nil) {
+        // first time this style is imported: parse it on its own, then keep its
+        // evaluated values around for the other styles importing it
+        NSMutableDictionary *importedValues = [[NSMutableDictionary alloc] init];
+        NSMutableDictionary *importedDynamicAssignments = [[NSMutableDictionary alloc] init];
+        [self parseStyle:styleName atPath:stylePath fromBundle:bundle intoStyleDescriptor:importedValues dynamicAssignments:importedDynamicAssignments];
+        importedStyleDescriptor = [importedValues copy];
+        self.importedStyleDescriptors[stylePath] = importedStyleDescriptor;
+        self.importedDynamicAssignments[stylePath] = [importedDynamicAssignments copy];
+    }
+    
+    // merge the imported values at this point of the style, so that they override
+    // the previous assignments and can be overridden by the following ones
+    [styleDescriptor addEntriesFromDictionary:importedStyleDescriptor];
+    [dynamicAssignments removeObjectsForKeys:importedStyleDescriptor.allKeys];
+    
+    // the imported values depending on the environment may have been evaluated
+    // with old environment values: evaluate them again from their own inputs (the
+    // values they saw in the imported style), then keep tracking them here
+    NSDictionary *importedDynamicAssignments = self.importedDynamicAssignments[stylePath];
+    NSMapTable *evaluatedValues = [self evaluatedValuesOfDynamicAssignments:importedDynamicAssignments.allValues forEnvironmentNames:nil];
+    for (ICSStyleDynamicAssignment *importedDynamicAssignment in importedDynamicAssignments.objectEnumerator) {
+        id evaluatedValue = [evaluatedValues objectForKey:importedDynamicAssignment];
+        if (evaluatedValue != nil) {
+            styleDescriptor[importedDynamicAssignment.key] = evaluatedValue;
+        }
+    }
+    [dynamicAssignments addEntriesFromDictionary:importedDynamicAssignments];
+}
+
+// Returns the path of a style imported by the style being parsed, or nil if the
+// style can't be found or is already being parsed (i.e. the import is cyclic), in
+// which case the import is skipped
+- (NSString *)pathForImportedStyle:(NSString *)styleName inBundle:(NSBundle *)bundle {
+    NSParameterAssert(styleName);
+    NSParameterAssert(bundle);
+    
+    // imported styles are looked up the same way as the ones passed to loadStyle:fromBundle:
+    NSString *stylePath = [self pathForStyle:styleName inBundle:bundle];
+    NSAssert(stylePath != nil, @"[ICSStyleManager]: Unable to find imported style `%@`", styleName);
+    if (stylePath == nil) {
+        return nil;
+    }
+    
+    BOOL cyclicImport = [self.parsingStylePaths containsObject:stylePath];
+    NSAssert(!cyclicImport, @"[ICSStyleManager]: Cyclic import of style `%@`", styleName);
+    
+    return (cyclicImport ? nil : stylePath);
 }
 
 #pragma mark Parse Assignment
 
-- (void)parseAssignmentOfValue:(NSString *)value toKey:(NSString *)keyName withGroups:(NSArray *)groups {
+- (id)parseAssignmentOfValue:(NSString *)value toKeyPath:(NSString *)keyPath inStyleDescriptor:(NSMutableDictionary *)styleDescriptor dynamicAssignments:(NSMutableDictionary *)dynamicAssignments {
     NSParameterAssert(value);
-    NSParameterAssert(keyName);
-    NSParameterAssert(groups);
+    NSParameterAssert(keyPath);
+    
+    id evaluatedValue = [self evaluatedValue:value inStyleDescriptor:styleDescriptor];
+    
+    if (evaluatedValue != nil) {
+        // value to be assigned has been evaluated
+        [self assignEvaluatedValue:evaluatedValue ofValue:value toKeyPath:keyPath inStyleDescriptor:styleDescriptor dynamicAssignments:dynamicAssignments];
+        return evaluatedValue;
+    }
+    
+    NSAssert(NO, @"[ICSStyleManager]: Attempt to assign unrecognized value `%@` to key `%@`", value, keyPath);
+    return nil;
+}
+
+- (void)assignEvaluatedValue:(id)evaluatedValue ofValue:(NSString *)value toKeyPath:(NSString *)keyPath inStyleDescriptor:(NSMutableDictionary *)styleDescriptor dynamicAssignments:(NSMutableDictionary *)dynamicAssignments {
+    NSParameterAssert(evaluatedValue);
+    NSParameterAssert(value);
+    NSParameterAssert(keyPath);
+    NSParameterAssert(styleDescriptor);
+    NSParameterAssert(dynamicAssignments);
+    
+    // assign evaluated value to the given key
+    styleDescriptor[keyPath] = evaluatedValue;
+    
+    // keep track of the assignments depending on environment values, either
+    // directly or through the variables they refer to
+    NSSet *environmentNames = [self environmentNamesOfValue:value withDynamicAssignments:dynamicAssignments];
+    if (environmentNames.count > 0) {
+        [self addDynamicAssignmentOfValue:value toKey:keyPath withEnvironmentNames:environmentNames inStyleDescriptor:styleDescriptor toDynamicAssignments:dynamicAssignments];
+    }
+    else {
+        [dynamicAssignments removeObjectForKey:keyPath];
+    }
+}
+
+- (id)evaluatedValue:(NSString *)value inStyleDescriptor:(NSDictionary *)styleDescriptor {
+    NSParameterAssert(value);
+    NSParameterAssert(styleDescriptor);
     
     id evaluatedValue = nil;
     
-    if ((evaluatedValue = [self parseAssignmentOfVariable:value])
-            || (evaluatedValue = [self parseAssignmentOfNumber:value])
+    if ((evaluatedValue = [self parseAssignmentOfVariable:value inStyleDescriptor:styleDescriptor])
+            || (evaluatedValue = [self parseAssignmentOfNumber:value inStyleDescriptor:styleDescriptor])
             || (evaluatedValue = [self parseAssignmentOfColor:value])
-            || (evaluatedValue = [self parseAssignmentOfCGValue:value])
-            || (evaluatedValue = [self parseAssignmentOfFont:value])
-            || (evaluatedValue = [self parseAssignmentOfImage:value])) {
-        // value to be assigned has been evaluated
-        
-        if (groups.count > 0) {
-            // build full key path taking groups into accout
-            NSString *groupPrefix = [[groups componentsJoinedByString:STOStyleGroupSeparator] stringByAppendingString:STOStyleGroupSeparator];
-            NSParameterAssert(groupPrefix);
-            keyName = [groupPrefix stringByAppendingString:keyName];
-            NSParameterAssert(keyName);
-        }
-        
-        // assign evaluated value to the given key
-        self.styleDescriptor[keyName] = evaluatedValue;
-        return;
+            || (evaluatedValue = [self parseAssignmentOfCGValue:value inStyleDescriptor:styleDescriptor])
+            || (evaluatedValue = [self parseAssignmentOfFont:value inStyleDescriptor:styleDescriptor])
+            || (evaluatedValue = [self parseAssignmentOfImage:value inStyleDescriptor:styleDescriptor])) {
+        return evaluatedValue;
+    }
+    
+    return nil;
+}
+
+- (NSString *)keyPathForKey:(NSString *)keyName withGroups:(NSArray *)groups {
+    NSParameterAssert(keyName);
+    NSParameterAssert(groups);
+    
+    if (groups.count > 0) {
+        // build full key path taking groups into accout
+        NSString *groupPrefix = [[groups componentsJoinedByString:STOStyleGroupSeparator] stringByAppendingString:STOStyleGroupSeparator];
+        NSParameterAssert(groupPrefix);
+        keyName = [groupPrefix stringByAppendingString:keyName];
+        NSParameterAssert(keyName);
     }
     
-    NSAssert(NO, @"[ICSStyleManager]: Attempt to assign unrecognized value `%@` to key `%@`", value, keyName);
+    return keyName;
 }
 
-- (id)parseAssignmentOfVariable:(NSString *)value {
+- (id)parseAssignmentOfVariable:(NSString *)value inStyleDescriptor:(NSDictionary *)styleDescriptor {
     NSArray *capturedSubstrings = [NSRegularExpression ics_capturedSubstringsWithFirstMatchOfPattern:STOStyleVariablePattern inString:value];
     if (capturedSubstrings.count == 1) {
         // obtain the value of the specified variable
         NSString *varName = capturedSubstrings[0];
-        id varValue = self.styleDescriptor[varName];
+        id varValue = ([varName hasPrefix:STOStyleEnvironmentPrefix]
+                       ? self.environment[[varName substringFromIndex:STOStyleEnvironmentPrefix.length]]
+                       : styleDescriptor[varName]);
         NSAssert(varValue, @"[ICSStyleManager]: Attempt to assign an undefined variable `%@`", varName);
         return varValue;
     }
@@ -303,10 +703,10 @@ static NSString *const STOStylePreferredFontStyleCaption2 = @"Caption2";
     return nil;
 }
 
-- (id)parseAssignmentOfNumber:(NSString *)value {
+- (id)parseAssignmentOfNumber:(NSString *)value inStyleDescriptor:(NSDictionary *)styleDescriptor {
     NSArray *capturedSubstrings =[NSRegularExpression ics_capturedSubstringsWithFirstMatchOfPattern:STOStyleNumberPattern inString:value];
     if (capturedSubstrings.count == 1) {
-        return [capturedSubstrings[0] sto_numberByEvaluatingStringWithStyleDescriptor:self.styleDescriptor];
+        return [capturedSubstrings[0] sto_numberByEvaluatingStringWithStyleDescriptor:styleDescriptor environment:self.environment];
     }
     
     return nil;
@@ -348,21 +748,26 @@ static NSString *const STOStylePreferredFontStyleCaption2 = @"Caption2";
     if (capturedSubstrings.count == 1) {
         NSString *patternImageName = capturedSubstrings[0];
         UIImage *patternImage = [self loadImageNamed:patternImageName];
-        return [UIColor colorWithPatternImage:patternImage];
+        if (patternImage != nil) {
+            [self.patternImages setObject:patternImage forKey:patternImageName];
+        }
+        UIColor *patternImageColor = [UIColor colorWithPatternImage:patternImage];
+        [self.patternImageColorNames setObject:patternImageName forKey:patternImageColor];
+        return patternImageColor;
     }
     
     return nil;
 }
 
-- (id)parseAssignmentOfCGValue:(NSString *)value {
+- (id)parseAssignmentOfCGValue:(NSString *)value inStyleDescriptor:(NSDictionary *)styleDescriptor {
     
     // test for rect
     NSArray *capturedSubstrings = [NSRegularExpression ics_capturedSubstringsWithFirstMatchOfPattern:STOStyleRectPattern inString:value];
     if (capturedSubstrings.count == 4) {
-        CGRect rect = CGRectMake([[capturedSubstrings[0] sto_numberByEvaluatingStringWithStyleDescriptor:self.styleDescriptor] floatValue],
-                                 [[capturedSubstrings[1] sto_numberByEvaluatingStringWithStyleDescriptor:self.styleDescriptor] floatValue],
-                                 [[capturedSubstrings[2] sto_numberByEvaluatingStringWithStyleDescriptor:self.styleDescriptor] floatValue],
-                                 [[capturedSubstrings[3] sto_numberByEvaluatingStringWithStyleDescriptor:self.styleDescriptor] floatValue]);
+        CGRect rect = CGRectMake([[capturedSubstrings[0] sto_numberByEvaluatingStringWithStyleDescriptor:styleDescriptor environment:self.environment] floatValue],
+                                 [[capturedSubstrings[1] sto_numberByEvaluatingStringWithStyleDescriptor:styleDescriptor environment:self.environment] floatValue],
+                                 [[capturedSubstrings[2] sto_numberByEvaluatingStringWithStyleDescriptor:styleDescriptor environment:self.environment] floatValue],
+                                 [[capturedSubstrings[3] sto_numberByEvaluatingStringWithStyleDescriptor:styleDescriptor environment:self.environment] floatValue]);
         return [NSValue valueWithCGRect:rect];
     }
 
@@ -370,8 +775,8 @@ static NSString *const STOStylePreferredFontStyleCaption2 = @"Caption2";
     // test for point
     capturedSubstrings = [NSRegularExpression ics_capturedSubstringsWithFirstMatchOfPattern:STOStylePointPattern inString:value];
     if (capturedSubstrings.count == 2) {
-        CGPoint point = CGPointMake([[capturedSubstrings[0] sto_numberByEvaluatingStringWithStyleDescriptor:self.styleDescriptor] floatValue],
-                                    [[capturedSubstrings[1] sto_numberByEvaluatingStringWithStyleDescriptor:self.styleDescriptor] floatValue]);
+        CGPoint point = CGPointMake([[capturedSubstrings[0] sto_numberByEvaluatingStringWithStyleDescriptor:styleDescriptor environment:self.environment] floatValue],
+                                    [[capturedSubstrings[1] sto_numberByEvaluatingStringWithStyleDescriptor:styleDescriptor environment:self.environment] floatValue]);
         return [NSValue valueWithCGPoint:point];
     }
 
@@ -379,20 +784,20 @@ static NSString *const STOStylePreferredFontStyleCaption2 = @"Caption2";
     // test for size
     capturedSubstrings = [NSRegularExpression ics_capturedSubstringsWithFirstMatchOfPattern:STOStyleSizePattern inString:value];
     if (capturedSubstrings.count == 2) {
-        CGSize size = CGSizeMake([[capturedSubstrings[0] sto_numberByEvaluatingStringWithStyleDescriptor:self.styleDescriptor] floatValue],
-                                 [[capturedSubstrings[1] sto_numberByEvaluatingStringWithStyleDescriptor:self.styleDescriptor] floatValue]);
+        CGSize size = CGSizeMake([[capturedSubstrings[0] sto_numberByEvaluatingStringWithStyleDescriptor:styleDescriptor environment:self.environment] floatValue],
+                                 [[capturedSubstrings[1] sto_numberByEvaluatingStringWithStyleDescriptor:styleDescriptor environment:self.environment] floatValue]);
         return [NSValue valueWithCGSize:size];
     }
     
     return nil;
 }
 
-- (id)parseAssignmentOfFont:(NSString *)value {
+- (id)parseAssignmentOfFont:(NSString *)value inStyleDescriptor:(NSDictionary *)styleDescriptor {
    
     // test for font
     NSArray *capturedSubstrings = [NSRegularExpression ics_capturedSubstringsWithFirstMatchOfPattern:STOStyleFontPattern inString:value];
     if (capturedSubstrings.count == 2) {
-        return [UIFont fontWithName:capturedSubstrings[0] size:[[capturedSubstrings[1] sto_numberByEvaluatingStringWithStyleDescriptor:self.styleDescriptor] floatValue]];
+        return [self fontWithName:capturedSubstrings[0] size:[[capturedSubstrings[1] sto_numberByEvaluatingStringWithStyleDescriptor:styleDescriptor environment:self.environment] floatValue]];
     }
     
     
@@ -421,13 +826,45 @@ static NSString *const STOStylePreferredFontStyleCaption2 = @"Caption2";
         }
         
         NSAssert(textStyle != nil, @"[ICSStyleManager]: Unrecognized text style for preferred font: `%@`", preferredFontStyle);
-        return [UIFont preferredFontForTextStyle:textStyle];
+        return [self preferredFontForTextStyle:textStyle];
     }
     
     return nil;
 }
 
-- (id)parseAssignmentOfImage:(NSString *)value {
+- (UIFont *)fontWithName:(NSString *)fontName size:(CGFloat)fontSize {
+    NSParameterAssert(fontName);
+    
+    NSArray *fontKey = @[fontName, @(fontSize)];
+    UIFont *font = self.fonts[fontKey];
+    
+    if (font == nil) {
+        font = [UIFont fontWithName:fontName size:fontSize];
+        if (font != nil) {
+            self.fonts[fontKey] = font;
+        }
+    }
+    
+    return font;
+}
+
+- (UIFont *)preferredFontForTextStyle:(NSString *)textStyle {
+    if (textStyle == nil) {
+        return nil;
+    }
+    
+    UIFont *font = self.preferredFonts[textStyle];
+    
+    if (font == nil) {
+        font = [UIFont preferredFontForTextStyle:textStyle];
+        self.preferredFonts[textStyle] = font;
+        [self.preferredFontTextStyles setObject:textStyle forKey:font];
+    }
+    
+    return font;
+}
+
+- (id)parseAssignmentOfImage:(NSString *)value inStyleDescriptor:(NSDictionary *)styleDescriptor {
     
     // test for image
     NSArray *capturedSubstrings = [NSRegularExpression ics_capturedSubstringsWithFirstMatchOfPattern:STOStyleImagePattern inString:value];
@@ -444,10 +881,10 @@ static NSString *const STOStylePreferredFontStyleCaption2 = @"Caption2";
         ICSStyleImageDescriptor *imageDescriptor = [[ICSStyleImageDescriptor alloc] init];
         imageDescriptor.name = capturedSubstrings[0];
         
-        UIEdgeInsets capInsets = UIEdgeInsetsMake([[capturedSubstrings[1] sto_numberByEvaluatingStringWithStyleDescriptor:self.styleDescriptor] floatValue],
-                                                  [[capturedSubstrings[2] sto_numberByEvaluatingStringWithStyleDescriptor:self.styleDescriptor] floatValue],
-                                                  [[capturedSubstrings[3] sto_numberByEvaluatingStringWithStyleDescriptor:self.styleDescriptor] floatValue],
-                                                  [[capturedSubstrings[4] sto_numberByEvaluatingStringWithStyleDescriptor:self.styleDescriptor] floatValue]);
+        UIEdgeInsets capInsets = UIEdgeInsetsMake([[capturedSubstrings[1] sto_numberByEvaluatingStringWithStyleDescriptor:styleDescriptor environment:self.environment] floatValue],
+                                                  [[capturedSubstrings[2] sto_numberByEvaluatingStringWithStyleDescriptor:styleDescriptor environment:self.environment] floatValue],
+                                                  [[capturedSubstrings[3] sto_numberByEvaluatingStringWithStyleDescriptor:styleDescriptor environment:self.environment] floatValue],
+                                                  [[capturedSubstrings[4] sto_numberByEvaluatingStringWithStyleDescriptor:styleDescriptor environment:self.environment] floatValue]);
         
         imageDescriptor.capInsets = [NSValue valueWithUIEdgeInsets:capInsets];
         
@@ -458,137 +895,1730 @@ static NSString *const STOStylePreferredFontStyleCaption2 = @"Caption2";
 }
 
 
-#pragma mark - Access Values
-
-- (CGFloat)floatForKey:(NSString *)key {
-    NSNumber *value = [self valueOfType:[NSNumber class] forKey:key];
-    return [value floatValue];
-}
-
-- (CGRect)rectForKey:(NSString *)key {
-    NSValue *value = [self valueOfType:[NSValue class] forKey:key];
-    return [value CGRectValue];
-}
+#pragma mark - Environment Values
 
-- (CGSize)sizeForKey:(NSString *)key {
-    NSValue *value = [self valueOfType:[NSValue class] forKey:key];
-    return [value CGSizeValue];
+- (void)setEnvironmentValue:(CGFloat)value forName:(NSString *)name {
+    NSParameterAssert(name);
+    [self setEnvironmentValues:@{name : @(value)}];
 }
 
-- (CGPoint)pointForKey:(NSString *)key {
-    NSValue *value = [self valueOfType:[NSValue class] forKey:key];
-    return [value CGPointValue];
+- (void)setEnvironmentValues:(NSDictionary *)environmentValues {
+    NSParameterAssert(environmentValues);
+    
+    if ([self postponeUntilDeferredLoadingFinishes:^{ [self setEnvironmentValues:environmentValues]; }]) {
+        return;
+    }
+    
+    NSMutableSet *changedNames = [[NSMutableSet alloc] init];
+    
+    for (NSString *name in environmentValues) {
+        NSNumber *value = environmentValues[name];
+        NSAssert([value isKindOfClass:[NSNumber class]], @"[ICSStyleManager]: Value of environment variable `%@` is not a number", name);
+        
+        if (![self.environment[name] isEqual:value]) {
+            self.environment[name] = value;
+            [changedNames addObject:name];
+        }
+    }
+    
+    if (changedNames.count == 0) {
+        return;
+    }
+    
+    // evaluate again only the assignments depending on the changed values
+    NSMapTable *evaluatedValues = [self evaluatedValuesOfDynamicAssignments:self.dynamicAssignments.allValues forEnvironmentNames:changedNames];
+    
+    for (ICSStyleDynamicAssignment *dynamicAssignment in self.dynamicAssignments.objectEnumerator) {
+        id evaluatedValue = [evaluatedValues objectForKey:dynamicAssignment];
+        if (evaluatedValue != nil) {
+            [self replaceValue:evaluatedValue forKey:dynamicAssignment.key];
+        }
+    }
+    
+    self.styleGeneration++;
+    
+#if defined(ICS_STYLE_MANAGER_LOG)
+    NSLog(@"[ICSStyleManager]: Environment changed, %lu values evaluated again", (unsigned long)evaluatedValues.count);
+#endif
 }
 
-- (UIFont *)fontForKey:(NSString *)key {
-    return [self valueOfType:[UIFont class] forKey:key];
+// Evaluates again the given dynamic assignments depending on the given environment
+// names (all of them if nil), along with the overridden assignments they refer to,
+// returning their new values keyed by assignment. Each assignment is evaluated
+// against the values its variables had when it was loaded, except for the ones
+// referring to other dynamic assignments, which see their new values
+- (NSMapTable *)evaluatedValuesOfDynamicAssignments:(NSArray *)dynamicAssignments forEnvironmentNames:(NSSet *)environmentNames {
+    NSParameterAssert(dynamicAssignments);
+    
+    // collect the assignments to be evaluated, following their dependencies since an
+    // assignment may refer to a value that has been overridden afterwards
+    NSMutableSet *changedAssignments = [[NSMutableSet alloc] init];
+    NSMutableArray *stack = [dynamicAssignments mutableCopy];
+    while (stack.count > 0) {
+        ICSStyleDynamicAssignment *dynamicAssignment = stack.lastObject;
+        [stack removeLastObject];
+        
+        if ([changedAssignments containsObject:dynamicAssignment]
+                || (environmentNames != nil && ![dynamicAssignment.environmentNames intersectsSet:environmentNames])) {
+            continue;
+        }
+        
+        [changedAssignments addObject:dynamicAssignment];
+        [stack addObjectsFromArray:dynamicAssignment.dependencies.allValues];
+    }
+    
+    NSMapTable *evaluatedValues = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsObjectPointerPersonality valueOptions:NSPointerFunctionsStrongMemory];
+    
+    // in the order they have been loaded, so that each one sees the new values of the
+    // ones it refers to
+    for (ICSStyleDynamicAssignment *dynamicAssignment in [self sortedDynamicAssignments:changedAssignments.allObjects]) {
+        for (NSString *varName in dynamicAssignment.dependencies) {
+            id varValue = [evaluatedValues objectForKey:dynamicAssignment.dependencies[varName]];
+            if (varValue != nil) {
+                dynamicAssignment.inputs[varName] = varValue;
+            }
+        }
+        
+        id evaluatedValue = [self evaluatedValue:dynamicAssignment.value inStyleDescriptor:dynamicAssignment.inputs];
+        NSAssert(evaluatedValue != nil, @"[ICSStyleManager]: Unable to evaluate again value `%@` of key `%@`", dynamicAssignment.value, dynamicAssignment.key);
+        
+        if (evaluatedValue != nil) {
+            [evaluatedValues setObject:evaluatedValue forKey:dynamicAssignment];
+        }
+    }
+    
+    return evaluatedValues;
 }
 
-- (UIImage *)imageForKey:(NSString *)key {
-    ICSStyleImageDescriptor *imageDescriptor = [self valueOfType:[ICSStyleImageDescriptor class] forKey:key];
+- (NSSet *)environmentNamesOfValue:(NSString *)value withDynamicAssignments:(NSDictionary *)dynamicAssignments {
+    NSParameterAssert(value);
+    NSParameterAssert(dynamicAssignments);
     
-    // load image from descriptor
-    UIImage *image = [self loadImageNamed:imageDescriptor.name];
+    NSMutableSet *environmentNames = [[NSMutableSet alloc] init];
     
-    if (imageDescriptor.capInsets != nil) {
-        // has cap insets => the image is resizable
-        image = [image resizableImageWithCapInsets:[imageDescriptor.capInsets UIEdgeInsetsValue]];
-        NSAssert(image != nil, @"[ICSStyleManager]: Unable to make image for key `%@` resizable", image);
+    for (NSString *varName in STOStyleVariableNamesInString(value)) {
+        if ([varName hasPrefix:STOStyleEnvironmentPrefix]) {
+            [environmentNames addObject:[varName substringFromIndex:STOStyleEnvironmentPrefix.length]];
+        }
+        else {
+            // a value also depends on the environment values the variables it refers to depend on
+            ICSStyleDynamicAssignment *dynamicAssignment = dynamicAssignments[varName];
+            if (dynamicAssignment != nil) {
+                [environmentNames unionSet:dynamicAssignment.environmentNames];
+            }
+        }
     }
     
-    return image;
+    return environmentNames;
 }
 
-- (UIColor *)colorForKey:(NSString *)key {
-    return [self valueOfType:[UIColor class] forKey:key];
+- (void)addDynamicAssignmentOfValue:(NSString *)value toKey:(NSString *)keyPath withEnvironmentNames:(NSSet *)environmentNames
+                  inStyleDescriptor:(NSDictionary *)styleDescriptor toDynamicAssignments:(NSMutableDictionary *)dynamicAssignments {
+    // keep the values the variables have at this point of the style, since the keys
+    // they refer to may be assigned other values afterwards
+    NSMutableDictionary *inputs = [[NSMutableDictionary alloc] init];
+    NSMutableDictionary *dependencies = [[NSMutableDictionary alloc] init];
+    for (NSString *varName in STOStyleVariableNamesInString(value)) {
+        if ([varName hasPrefix:STOStyleEnvironmentPrefix]) {
+            continue;
+        }
+        
+        id varValue = styleDescriptor[varName];
+        if (varValue != nil) {
+            inputs[varName] = varValue;
+        }
+        
+        ICSStyleDynamicAssignment *dependency = dynamicAssignments[varName];
+        if (dependency != nil) {
+            dependencies[varName] = dependency;
+        }
+    }
+    
+    ICSStyleDynamicAssignment *dynamicAssignment = [[ICSStyleDynamicAssignment alloc] init];
+    dynamicAssignment.key = keyPath;
+    dynamicAssignment.value = value;
+    dynamicAssignment.environmentNames = environmentNames;
+    dynamicAssignment.order = self.dynamicAssignmentCount++;
+    dynamicAssignment.inputs = inputs;
+    dynamicAssignment.dependencies = dependencies;
+    dynamicAssignments[keyPath] = dynamicAssignment;
 }
 
-- (NSUInteger)unsignedIntegerForKey:(NSString *)key {
-    NSNumber *value = [self valueOfType:[NSNumber class] forKey:key];
-    return [value unsignedIntegerValue];
+- (NSArray *)sortedDynamicAssignments:(NSArray *)dynamicAssignments {
+    return [dynamicAssignments sortedArrayUsingComparator:^NSComparisonResult(ICSStyleDynamicAssignment *dynamicAssignment1, ICSStyleDynamicAssignment *dynamicAssignment2) {
+        if (dynamicAssignment1.order < dynamicAssignment2.order) {
+            return NSOrderedAscending;
+        }
+        return (dynamicAssignment1.order > dynamicAssignment2.order ? NSOrderedDescending : NSOrderedSame);
+    }];
 }
 
-- (NSInteger)integerForKey:(NSString *)key {
-    NSNumber *value = [self valueOfType:[NSNumber class] forKey:key];
-    return [value integerValue];
+- (void)replaceValue:(id)value forKey:(NSString *)key {
+    NSParameterAssert(value);
+    NSParameterAssert(key);
+    
+    [self replaceKeyTableValue:value forKey:key];
+    
+    if (self.compactStyleDescriptor != nil && [self.compactStyleDescriptor replaceObject:value forKey:key]) {
+        // value replaced in place
+        return;
+    }
+    
+    [self expandCompactStyleDescriptor];
+    self.styleDescriptor[key] = value;
 }
 
-- (NSTimeInterval)timeIntervalForKey:(NSString *)key {
-    NSNumber *value = [self valueOfType:[NSNumber class] forKey:key];
-    return [value doubleValue];
+// Updates the value of a key in the key table values, if they have been filled
+- (void)replaceKeyTableValue:(id)value forKey:(NSString *)key {
+    if (self.keyTableValues == nil) {
+        return;
+    }
+    
+    NSUInteger index = [self.keyTable indexOfKey:key];
+    if (index != NSNotFound) {
+        self.keyTableValues[index] = value;
+    }
 }
 
-- (id)valueOfType:(Class)class forKey:(NSString *)key {
-    NSParameterAssert(class);
-    NSParameterAssert(key);
-    id value = self.styleDescriptor[key];
-    NSAssert(value != nil, @"[ICSStyleManager]: Undefined key `%@`", key);
-    NSAssert([value isKindOfClass:class], @"[ICSStyleManager]: Value for key `%@` is not of type `%@`", key, NSStringFromClass(class));
-    return value;
-}
 
-- (UIImage *)loadImageNamed:(NSString *)imageName {
-    NSParameterAssert(imageName);
-    
-    UIImage *image;
+#pragma mark - Dynamic Type
+
+- (void)contentSizeCategoryDidChange:(NSNotification *)notification {
+    if ([self postponeUntilDeferredLoadingFinishes:^{ [self contentSizeCategoryDidChange:notification]; }]) {
+        return;
+    }
+    
+    // preferred fonts are sized according to the content size category, so they
+    // need to be created again; all the other fonts are still valid
+    NSMapTable *preferredFontTextStyles = [self.preferredFontTextStyles copy];
+    [self.preferredFonts removeAllObjects];
+    [self.preferredFontTextStyles removeAllObjects];
+    
+    id (^refreshedFont)(id) = ^id(id value) {
+        NSString *textStyle = [preferredFontTextStyles objectForKey:value];
+        return (textStyle != nil ? [self preferredFontForTextStyle:textStyle] : nil);
+    };
+    
+    // replace only the preferred fonts, wherever they have been assigned
+    if (self.compactStyleDescriptor != nil) {
+        [self.compactStyleDescriptor replaceObjectsUsingBlock:refreshedFont];
+    }
+    else {
+        STOStyleReplaceObjectsInDictionary(self.styleDescriptor, refreshedFont);
+    }
+    
+    for (NSUInteger idx = 0; idx < self.keyTableValues.count; idx++) {
+        id font = refreshedFont(self.keyTableValues[idx]);
+        if (font != nil) {
+            self.keyTableValues[idx] = font;
+        }
+    }
+    
+    // imported styles are refreshed as well for the styles importing them later
+    for (NSString *stylePath in self.importedStyleDescriptors.allKeys) {
+        NSMutableDictionary *importedStyleDescriptor = [self.importedStyleDescriptors[stylePath] mutableCopy];
+        STOStyleReplaceObjectsInDictionary(importedStyleDescriptor, refreshedFont);
+        self.importedStyleDescriptors[stylePath] = [importedStyleDescriptor copy];
+    }
+    
+    self.styleGeneration++;
+    
+#if defined(ICS_STYLE_MANAGER_LOG)
+    NSLog(@"[ICSStyleManager]: Content size category changed, %lu preferred fonts created again", (unsigned long)self.preferredFonts.count);
+#endif
+}
+
+
+#pragma mark - Access Profile
+
+- (void)startRecordingAccessProfile {
+    self.accessProfile = [[NSMutableOrderedSet alloc] init];
+}
+
+- (BOOL)stopRecordingAccessProfileAndWriteToFile:(NSString *)path {
+    NSParameterAssert(path);
+    NSAssert(self.accessProfile != nil, @"[ICSStyleManager]: Access profile is not being recorded");
+    
+    NSArray *accessProfile = self.accessProfile.array;
+    self.accessProfile = nil;
+    
+#if defined(ICS_STYLE_MANAGER_LOG)
+    NSLog(@"[ICSStyleManager]: Access profile recorded, %lu keys read", (unsigned long)accessProfile.count);
+#endif
+    
+    return [accessProfile writeToFile:path atomically:YES];
+}
+
+- (void)loadStyle:(NSString *)styleName fromBundle:(NSBundle *)bundle withAccessProfileAtPath:(NSString *)accessProfilePath {
+    NSParameterAssert(styleName);
+    [self loadStyles:@[styleName] fromBundle:bundle withAccessProfileAtPath:accessProfilePath];
+}
+
+- (void)loadStyles:(NSArray *)styleNames fromBundle:(NSBundle *)bundle withAccessProfileAtPath:(NSString *)accessProfilePath {
+    NSParameterAssert(styleNames.count > 0);
+    NSParameterAssert(bundle);
+    NSParameterAssert(accessProfilePath);
+    
+    NSArray *accessProfile = [NSArray arrayWithContentsOfFile:accessProfilePath];
+    if (accessProfile == nil) {
+        // no profile has been recorded yet: load the whole styles right away
+        for (NSString *styleName in styleNames) {
+            [self loadStyle:styleName fromBundle:bundle];
+        }
+        return;
+    }
+    
+    [self waitForDeferredLoading];
+    [self expandCompactStyleDescriptor];
+    
+    // the assignments of all the styles are evaluated as a single style, in the
+    // order the styles are given; each one is applied as if it was being parsed
+    // from the style file declaring it
+    NSMutableArray *assignments = [[NSMutableArray alloc] init];
+    NSMutableArray *assignmentStylePaths = [[NSMutableArray alloc] init];
+    
+    for (NSString *styleName in styleNames) {
+        NSString *stylePath = [self pathForStyle:styleName inBundle:bundle];
+        NSArray *styleAssignments = [self assignmentsOfStyle:styleName atPath:stylePath];
+        
+        for (ICSStyleAssignment *assignment in styleAssignments) {
+            [assignments addObject:assignment];
+            [assignmentStylePaths addObject:stylePath];
+        }
+    }
+    
+    // imports are always evaluated right away, since the keys they define are
+    // only known once they have been parsed (they are cached anyway)
+    NSMutableIndexSet *launchIndexes = [[NSMutableIndexSet alloc] init];
+    NSMutableDictionary *assignmentIndexes = [[NSMutableDictionary alloc] init];
+    
+    [assignments enumerateObjectsUsingBlock:^(ICSStyleAssignment *assignment, NSUInteger idx, BOOL *stop) {
+        if (assignment.importedStyleName != nil) {
+            [launchIndexes addIndex:idx];
+            return;
+        }
+        
+        NSMutableArray *keyIndexes = assignmentIndexes[assignment.keyPath];
+        if (keyIndexes == nil) {
+            keyIndexes = [[NSMutableArray alloc] init];
+            assignmentIndexes[assignment.keyPath] = keyIndexes;
+        }
+        [keyIndexes addObject:@(idx)];
+    }];
+    
+    // the launch working set is made of the last assignment of each profiled key
+    // and, transitively, of the assignments the variables of their values refer to
+    NSMutableArray *profileIndexes = [[NSMutableArray alloc] init];
+    for (NSString *key in accessProfile) {
+        NSNumber *lastIndex = [assignmentIndexes[key] lastObject];
+        if (lastIndex != nil) {
+            [profileIndexes addObject:lastIndex];
+        }
+    }
+    
+    [self addIndexes:profileIndexes ofAssignments:assignments withAssignmentIndexes:assignmentIndexes toIndexes:launchIndexes];
+    
+    // evaluate the launch working set on the calling thread, in file order
+    NSDictionary *previousStyleDescriptor = [self.styleDescriptor copy];
+    NSMutableDictionary *launchStyleDescriptor = [self.styleDescriptor mutableCopy];
+    NSMutableDictionary *launchDynamicAssignments = [[NSMutableDictionary alloc] init];
+    NSMutableDictionary *launchValues = [[NSMutableDictionary alloc] init];
+    
+    for (NSUInteger idx = launchIndexes.firstIndex; idx != NSNotFound; idx = [launchIndexes indexGreaterThanIndex:idx]) {
+        [self.parsingStylePaths addObject:assignmentStylePaths[idx]];
+        id evaluatedValue = [self applyAssignment:assignments[idx] fromBundle:bundle withEvaluatedValue:nil toStyleDescriptor:launchStyleDescriptor dynamicAssignments:launchDynamicAssignments];
+        [self.parsingStylePaths removeLastObject];
+        
+        if (evaluatedValue != nil) {
+            launchValues[@(idx)] = evaluatedValue;
+        }
+    }
+    
+    // a key gets its final value from the last assignment or import defining it:
+    // the keys whose final value has already been evaluated are stored right away
+    NSMutableDictionary *finalIndexes = [[NSMutableDictionary alloc] init];
+    [assignments enumerateObjectsUsingBlock:^(ICSStyleAssignment *assignment, NSUInteger idx, BOOL *stop) {
+        if (assignment.importedStyleName != nil) {
+            NSString *importedStylePath = [self pathForStyle:assignment.importedStyleName inBundle:bundle];
+            for (NSString *key in self.importedStyleDescriptors[importedStylePath]) {
+                finalIndexes[key] = @(idx);
+            }
+        }
+        else {
+            finalIndexes[assignment.keyPath] = @(idx);
+        }
+    }];
+    
+    ICSStyleDeferredLoading *deferredLoading = [[ICSStyleDeferredLoading alloc] init];
+    
+    // the key table is not used until the whole style has been evaluated
+    self.keyTableValues = nil;
+    
+    for (NSString *key in finalIndexes) {
+        if ([launchIndexes containsIndex:[finalIndexes[key] unsignedIntegerValue]]) {
+            self.styleDescriptor[key] = launchStyleDescriptor[key];
+        }
+        else {
+            [deferredLoading.pendingKeys addObject:key];
+        }
+    }
+    
+    self.styleGeneration++;
+    
+#if defined(ICS_STYLE_MANAGER_LOG)
+    NSLog(@"[ICSStyleManager]: Styles `%@` loaded with access profile: %lu of %lu assignments evaluated at launch", [styleNames componentsJoinedByString:@"`, `"], (unsigned long)launchIndexes.count, (unsigned long)assignments.count);
+#endif
+    
+    if (deferredLoading.pendingKeys.count == 0) {
+        return;
+    }
+    
+    // a key read before the background queue gets to it is evaluated on the reading
+    // thread, along with the assignments it refers to, instead of waiting for it
+    __weak ICSStyleManager *weakSelf = self;
+    __weak ICSStyleDeferredLoading *weakDeferredLoading = deferredLoading;
+    deferredLoading.evaluatePendingKey = ^(NSString *key) {
+        ICSStyleDeferredLoading *deferredLoading = weakDeferredLoading;
+        ICSStyleManager *strongSelf = weakSelf;
+        
+        NSMutableIndexSet *indexes = [launchIndexes mutableCopy];
+        [strongSelf addIndexes:@[finalIndexes[key]] ofAssignments:assignments withAssignmentIndexes:assignmentIndexes toIndexes:indexes];
+        
+        NSMutableDictionary *styleDescriptor = [previousStyleDescriptor mutableCopy];
+        NSMutableDictionary *dynamicAssignments = [[NSMutableDictionary alloc] init];
+        
+        for (NSUInteger idx = indexes.firstIndex; idx != NSNotFound; idx = [indexes indexGreaterThanIndex:idx]) {
+            ICSStyleAssignment *assignment = assignments[idx];
+            
+            [strongSelf.parsingStylePaths addObject:assignmentStylePaths[idx]];
+            [strongSelf applyAssignment:assignment fromBundle:bundle withEvaluatedValue:launchValues[@(idx)] toStyleDescriptor:styleDescriptor dynamicAssignments:dynamicAssignments];
+            [strongSelf.parsingStylePaths removeLastObject];
+            
+            // store every pending key whose final value has been evaluated on the way
+            if (assignment.keyPath != nil && [finalIndexes[assignment.keyPath] unsignedIntegerValue] == idx) {
+                [strongSelf publishValue:styleDescriptor[assignment.keyPath] forKey:assignment.keyPath ofDeferredLoading:deferredLoading];
+            }
+        }
+    };
+    
+    // evaluate the whole style again in file order on a background queue, reusing the
+    // values evaluated at launch, so that the dynamic assignments are tracked in order
+    // and each remaining key is stored as soon as its final value is known
+    self.deferredLoading = deferredLoading;
+    
+    dispatch_async(dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+        NSMutableDictionary *styleDescriptor = [previousStyleDescriptor mutableCopy];
+        
+        [assignments enumerateObjectsUsingBlock:^(ICSStyleAssignment *assignment, NSUInteger idx, BOOL *stop) {
+            // each assignment is evaluated with the evaluation lock held, so that a reading
+            // thread evaluating a pending key never waits for more than one assignment
+            [deferredLoading.evaluationLock lock];
+            
+            [self.parsingStylePaths addObject:assignmentStylePaths[idx]];
+            [self applyAssignment:assignment fromBundle:bundle withEvaluatedValue:launchValues[@(idx)] toStyleDescriptor:styleDescriptor dynamicAssignments:self.dynamicAssignments];
+            [self.parsingStylePaths removeLastObject];
+            
+            [deferredLoading.evaluationLock unlock];
+            
+            if (assignment.keyPath != nil && [finalIndexes[assignment.keyPath] unsignedIntegerValue] == idx) {
+                [self publishValue:styleDescriptor[assignment.keyPath] forKey:assignment.keyPath ofDeferredLoading:deferredLoading];
+            }
+        }];
+        
+        [deferredLoading.condition lock];
+        deferredLoading.finished = YES;
+        [deferredLoading.condition broadcast];
+        [deferredLoading.condition unlock];
+        
+        // the operations postponed while evaluating the style are run on the main queue
+        dispatch_async(dispatch_get_main_queue(), ^{
+            if (self.deferredLoading == deferredLoading) {
+                [self waitForDeferredLoading];
+            }
+        });
+    });
+}
+
+// Stores the final value of a key of a style being loaded on a background queue,
+// unless it has already been stored. The condition is only held while storing it
+- (void)publishValue:(id)value forKey:(NSString *)key ofDeferredLoading:(ICSStyleDeferredLoading *)deferredLoading {
+    [deferredLoading.condition lock];
+    if ([deferredLoading.pendingKeys containsObject:key]) {
+        self.styleDescriptor[key] = value;
+        [deferredLoading.pendingKeys removeObject:key];
+    }
+    [deferredLoading.condition unlock];
+}
+
+// Adds to the given indexes the assignments at the given indexes (when not already
+// included) and, transitively, the assignments the variables of their values refer to
+- (void)addIndexes:(NSArray *)assignmentIndexesToAdd ofAssignments:(NSArray *)assignments withAssignmentIndexes:(NSDictionary *)assignmentIndexes toIndexes:(NSMutableIndexSet *)indexes {
+    NSMutableArray *stack = [assignmentIndexesToAdd mutableCopy];
+    
+    while (stack.count > 0) {
+        NSUInteger idx = [stack.lastObject unsignedIntegerValue];
+        [stack removeLastObject];
+        
+        if ([indexes containsIndex:idx]) {
+            continue;
+        }
+        [indexes addIndex:idx];
+        
+        for (NSString *varName in STOStyleVariableNamesInString([assignments[idx] value])) {
+            // a variable refers to the last assignment to its key preceding this one
+            for (NSNumber *varIndex in [assignmentIndexes[varName] reverseObjectEnumerator]) {
+                if ([varIndex unsignedIntegerValue] < idx) {
+                    [stack addObject:varIndex];
+                    break;
+                }
+            }
+        }
+    }
+}
+
+// Returns the value of a key of a style being loaded on a background queue,
+// evaluating it on the calling thread if it hasn't been evaluated yet
+- (id)deferredValueForKey:(NSString *)key {
+    ICSStyleDeferredLoading *deferredLoading = self.deferredLoading;
+    
+    [deferredLoading.condition lock];
+    BOOL pending = [deferredLoading.pendingKeys containsObject:key];
+    [deferredLoading.condition unlock];
+    
+    if (pending) {
+        // the condition is not held while evaluating, so that the image loader can
+        // read values of the style from the thread evaluating it
+        [deferredLoading.evaluationLock lock];
+        
+        [deferredLoading.condition lock];
+        pending = [deferredLoading.pendingKeys containsObject:key];
+        [deferredLoading.condition unlock];
+        
+        if (pending) {
+            deferredLoading.evaluatePendingKey(key);
+        }
+        
+        [deferredLoading.evaluationLock unlock];
+    }
+    
+    [deferredLoading.condition lock];
+    id value = self.styleDescriptor[key];
+    [deferredLoading.condition unlock];
+    
+    return value;
+}
+
+// Waits for the style being loaded on a background queue, if any, to be
+// completely evaluated, then runs the operations postponed in the meantime.
+// Called on the main thread before changing the state shared with the background
+// evaluation; when the evaluation finishes by itself it is called on the main queue
+- (void)waitForDeferredLoading {
+    ICSStyleDeferredLoading *deferredLoading = self.deferredLoading;
+    if (deferredLoading == nil) {
+        return;
+    }
+    
+    [deferredLoading.condition lock];
+    while (!deferredLoading.finished) {
+        [deferredLoading.condition wait];
+    }
+    [deferredLoading.condition unlock];
+    
+    // from now on the values can be read without locking
+    self.deferredLoading = nil;
+    
+    for (void (^operation)(void) in deferredLoading.postponedOperations) {
+        operation();
+    }
+}
+
+// Postpones an operation until the style being loaded on a background queue has
+// been completely evaluated, instead of blocking the main thread to wait for it.
+// Returns NO if no style is being evaluated, and the operation can run right away
+- (BOOL)postponeUntilDeferredLoadingFinishes:(void (^)(void))operation {
+    ICSStyleDeferredLoading *deferredLoading = self.deferredLoading;
+    if (deferredLoading == nil) {
+        return NO;
+    }
+    
+    [deferredLoading.postponedOperations addObject:[operation copy]];
+    return YES;
+}
+
+
+#pragma mark - Unread Keys
+
+- (void)startTrackingReadKeys {
+    self.readKeys = [[NSMutableSet alloc] init];
+}
+
+- (NSArray *)unreadKeys {
+    NSAssert(self.readKeys != nil, @"[ICSStyleManager]: Read keys are not being tracked");
+    if (self.readKeys == nil) {
+        // without tracking every key would look unread, and be pruned
+        return nil;
+    }
+    
+    [self waitForDeferredLoading];
+    
+    NSArray *keys = (self.compactStyleDescriptor != nil ? [self.compactStyleDescriptor allKeys] : self.styleDescriptor.allKeys);
+    NSMutableArray *unreadKeys = [[NSMutableArray alloc] init];
+    
+    for (NSString *key in keys) {
+        if (![self.readKeys containsObject:key]) {
+            [unreadKeys addObject:key];
+        }
+    }
+    
+    return [unreadKeys sortedArrayUsingSelector:@selector(compare:)];
+}
+
+- (BOOL)writeUnreadKeysToFile:(NSString *)path {
+    NSParameterAssert(path);
+    
+    // one key per line, so that the file can be easily processed by offline tools
+    NSArray *unreadKeys = [self unreadKeys];
+    if (unreadKeys == nil) {
+        return NO;
+    }
+    
+    NSString *text = [[unreadKeys componentsJoinedByString:@"\n"] stringByAppendingString:@"\n"];
+    
+#if defined(ICS_STYLE_MANAGER_LOG)
+    NSLog(@"[ICSStyleManager]: %lu keys never read, written to `%@`", (unsigned long)unreadKeys.count, path);
+#endif
+    
+    return [text writeToFile:path atomically:YES encoding:NSUTF8StringEncoding error:NULL];
+}
+
+
+#pragma mark - Access Values
+
+- (CGFloat)floatForKey:(NSString *)key {
+    return (CGFloat)[self numberForKey:key];
+}
+
+- (CGRect)rectForKey:(NSString *)key {
+    if (self.compactStyleDescriptor != nil) {
+        double scalars[4];
+        [self getCompactScalars:scalars ofType:STOStyleCompactValueTypeRect forKey:key];
+        return CGRectMake(scalars[0], scalars[1], scalars[2], scalars[3]);
+    }
+    
+    NSValue *value = [self valueOfType:[NSValue class] forKey:key];
+    return [value CGRectValue];
+}
+
+- (CGSize)sizeForKey:(NSString *)key {
+    if (self.compactStyleDescriptor != nil) {
+        double scalars[2];
+        [self getCompactScalars:scalars ofType:STOStyleCompactValueTypeSize forKey:key];
+        return CGSizeMake(scalars[0], scalars[1]);
+    }
+    
+    NSValue *value = [self valueOfType:[NSValue class] forKey:key];
+    return [value CGSizeValue];
+}
+
+- (CGPoint)pointForKey:(NSString *)key {
+    if (self.compactStyleDescriptor != nil) {
+        double scalars[2];
+        [self getCompactScalars:scalars ofType:STOStyleCompactValueTypePoint forKey:key];
+        return CGPointMake(scalars[0], scalars[1]);
+    }
+    
+    NSValue *value = [self valueOfType:[NSValue class] forKey:key];
+    return [value CGPointValue];
+}
+
+- (UIFont *)fontForKey:(NSString *)key {
+    return [self valueOfType:[UIFont class] forKey:key];
+}
+
+- (UIImage *)imageForKey:(NSString *)key {
+    ICSStyleImageDescriptor *imageDescriptor = [self valueOfType:[ICSStyleImageDescriptor class] forKey:key];
+    
+    if (imageDescriptor.decodedImage != nil) {
+        // the image has already been prefetched
+        return imageDescriptor.decodedImage;
+    }
+    
+    // load image from descriptor
+    UIImage *image = [self loadImageNamed:imageDescriptor.name];
+    
+    if (imageDescriptor.capInsets != nil) {
+        // has cap insets => the image is resizable
+        image = [image resizableImageWithCapInsets:[imageDescriptor.capInsets UIEdgeInsetsValue]];
+        NSAssert(image != nil, @"[ICSStyleManager]: Unable to make image for key `%@` resizable", image);
+    }
+    
+    return image;
+}
+
+- (UIColor *)colorForKey:(NSString *)key {
+    return [self valueOfType:[UIColor class] forKey:key];
+}
+
+- (NSUInteger)unsignedIntegerForKey:(NSString *)key {
+    return STOStyleUnsignedIntegerFromNumber([self numberForKey:key]);
+}
+
+- (NSInteger)integerForKey:(NSString *)key {
+    return STOStyleIntegerFromNumber([self numberForKey:key]);
+}
+
+- (NSTimeInterval)timeIntervalForKey:(NSString *)key {
+    return [self numberForKey:key];
+}
+
+- (double)numberForKey:(NSString *)key {
+    if (self.compactStyleDescriptor != nil) {
+        double number;
+        [self getCompactScalars:&number ofType:STOStyleCompactValueTypeNumber forKey:key];
+        return number;
+    }
+    
+    NSNumber *value = [self valueOfType:[NSNumber class] forKey:key];
+    return [value doubleValue];
+}
+
+- (void)getCompactScalars:(double *)scalars ofType:(STOStyleCompactValueType)type forKey:(NSString *)key {
+    NSParameterAssert(scalars);
+    NSParameterAssert(key);
+    
+    if (self.accessProfile != nil) {
+        [self.accessProfile addObject:key];
+    }
+    if (self.readKeys != nil) {
+        [self.readKeys addObject:key];
+    }
+    
+    BOOL found = [self.compactStyleDescriptor getScalars:scalars ofType:type forKey:key];
+    NSAssert(found, @"[ICSStyleManager]: Undefined key `%@` or value of unexpected type", key);
+    (void)found;
+}
+
+- (ICSStyleValueBatch *)valueBatchWithRequests:(const ICSStyleValueRequest *)requests count:(NSUInteger)count {
+    NSParameterAssert(requests != NULL || count == 0);
+    return [[ICSStyleValueBatch alloc] initWithStyleManager:self requests:requests count:count];
+}
+
+- (id)valueOfType:(Class)class forKey:(NSString *)key {
+    NSParameterAssert(class);
+    NSParameterAssert(key);
+    
+    if (self.accessProfile != nil) {
+        [self.accessProfile addObject:key];
+    }
+    if (self.readKeys != nil) {
+        [self.readKeys addObject:key];
+    }
+    
+    id value = nil;
+    if (self.keyTable != nil && self.deferredLoading == nil) {
+        // keys of the key table are found with a single string comparison
+        value = [self keyTableValueForKey:key];
+    }
+    
+    if (value == nil) {
+        if (self.compactStyleDescriptor != nil) {
+            value = [self.compactStyleDescriptor objectForKey:key];
+        }
+        else if (self.deferredLoading != nil) {
+            value = [self deferredValueForKey:key];
+        }
+        else {
+            value = self.styleDescriptor[key];
+        }
+    }
+    
+    NSAssert(value != nil, @"[ICSStyleManager]: Undefined key `%@`", key);
+    NSAssert([value isKindOfClass:class], @"[ICSStyleManager]: Value for key `%@` is not of type `%@`", key, NSStringFromClass(class));
+    return value;
+}
+
+- (UIImage *)loadImageNamed:(NSString *)imageName {
+    NSParameterAssert(imageName);
+    
+    UIImage *image;
+    
+    if (self.imageLoader != nil) {
+        // ask image loader for the image with the given name
+        image = [self.imageLoader styleManager:self imageNamed:imageName];
+    }
+    else {
+        // no image loader, load the image with +[UIImage imageNamed:]
+        image = [UIImage imageNamed:imageName];
+    }
+    
+    NSAssert(image != nil, @"[ICSStyleManager]: Unable to load image named `%@`", imageName);
+    return image;
+}
+
+
+#pragma mark - Prefetch Images
+
+- (void)prefetchImagesForKey:(NSString *)key completion:(void (^)(void))completion {
+    NSParameterAssert(key);
+    
+    if ([self postponeUntilDeferredLoadingFinishes:^{ [self prefetchImagesForKey:key completion:completion]; }]) {
+        return;
+    }
+    
+    // collect the images referred to by the given key, or by all the keys of
+    // the given group of values
+    NSString *groupPrefix = [key stringByAppendingString:STOStyleGroupSeparator];
+    NSMutableArray *imageDescriptors = [[NSMutableArray alloc] init];
+    NSMutableDictionary *patternImageColorKeys = [[NSMutableDictionary alloc] init];
+    
+    void (^collectImages)(NSString *, id) = ^(NSString *valueKey, id value) {
+        if (![valueKey isEqualToString:key] && ![valueKey hasPrefix:groupPrefix]) {
+            return;
+        }
+        
+        if ([value isKindOfClass:[ICSStyleImageDescriptor class]]) {
+            if ([value decodedImage] == nil) {
+                [imageDescriptors addObject:value];
+            }
+            return;
+        }
+        
+        NSString *patternImageName = [self.patternImageColorNames objectForKey:value];
+        if (patternImageName != nil) {
+            NSMutableArray *colorKeys = patternImageColorKeys[patternImageName];
+            if (colorKeys == nil) {
+                colorKeys = [[NSMutableArray alloc] init];
+                patternImageColorKeys[patternImageName] = colorKeys;
+            }
+            [colorKeys addObject:@[valueKey, value]];
+        }
+    };
+    
+    if (self.compactStyleDescriptor != nil) {
+        [self.compactStyleDescriptor enumerateObjectsUsingBlock:collectImages];
+    }
+    else {
+        [self.styleDescriptor enumerateKeysAndObjectsUsingBlock:^(NSString *valueKey, id value, BOOL *stop) {
+            collectImages(valueKey, value);
+        }];
+    }
+    
+    // images are loaded and decoded on the prefetch queue, then handed back on the
+    // main queue, where the values of the style are read
+    NSBlockOperation *completionOperation = [NSBlockOperation blockOperationWithBlock:^{
+        dispatch_async(dispatch_get_main_queue(), ^{
+            // the decoded images have been stored by blocks enqueued on the main queue
+            // before this one: batches of values holding the loaded images are outdated
+            self.styleGeneration++;
+            
+#if defined(ICS_STYLE_MANAGER_LOG)
+            NSLog(@"[ICSStyleManager]: Images for key `%@` prefetched (%lu images, %lu pattern images)", key, (unsigned long)imageDescriptors.count, (unsigned long)patternImageColorKeys.count);
+#endif
+            if (completion != nil) {
+                completion();
+            }
+        });
+    }];
+    
+    for (ICSStyleImageDescriptor *imageDescriptor in imageDescriptors) {
+        NSOperation *operation = [NSBlockOperation blockOperationWithBlock:^{
+            UIImage *image = STOStyleDecodedImage([self loadImageNamed:imageDescriptor.name]);
+            if (imageDescriptor.capInsets != nil) {
+                image = [image resizableImageWithCapInsets:[imageDescriptor.capInsets UIEdgeInsetsValue]];
+            }
+            
+            dispatch_async(dispatch_get_main_queue(), ^{
+                imageDescriptor.decodedImage = image;
+            });
+        }];
+        [completionOperation addDependency:operation];
+        [self.imagePrefetchQueue addOperation:operation];
+    }
+    
+    for (NSString *patternImageName in patternImageColorKeys) {
+        NSArray *colorKeys = patternImageColorKeys[patternImageName];
+        NSOperation *operation = [NSBlockOperation blockOperationWithBlock:^{
+            UIImage *patternImage = STOStyleDecodedImage([self loadImageNamed:patternImageName]);
+            
+            dispatch_async(dispatch_get_main_queue(), ^{
+                [self replacePatternImageColors:colorKeys withPatternImage:patternImage named:patternImageName];
+            });
+        }];
+        [completionOperation addDependency:operation];
+        [self.imagePrefetchQueue addOperation:operation];
+    }
+    
+    [self.imagePrefetchQueue addOperation:completionOperation];
+}
+
+// Replaces the pattern image colors assigned to the given keys (each one as a
+// pair of key and color) with colors using a prefetched pattern image
+- (void)replacePatternImageColors:(NSArray *)colorKeys withPatternImage:(UIImage *)patternImage named:(NSString *)patternImageName {
+    if (patternImage == nil) {
+        return;
+    }
+    
+    // a style may be being evaluated in background: replace the values with its
+    // condition locked, as the background queue does when storing them
+    ICSStyleDeferredLoading *deferredLoading = self.deferredLoading;
+    [deferredLoading.condition lock];
+    
+    UIColor *patternImageColor = [UIColor colorWithPatternImage:patternImage];
+    [self.patternImageColorNames setObject:patternImageName forKey:patternImageColor];
+    [self.patternImages setObject:patternImage forKey:patternImageName];
+    
+    for (NSArray *colorKey in colorKeys) {
+        NSString *key = colorKey[0];
+        id currentValue = (self.compactStyleDescriptor != nil ? [self.compactStyleDescriptor objectForKey:key] : self.styleDescriptor[key]);
+        
+        if (currentValue == colorKey[1]) {
+            // the key hasn't been assigned another value in the meantime
+            [self replaceValue:patternImageColor forKey:key];
+        }
+    }
+    
+    [deferredLoading.condition unlock];
+    
+    self.styleGeneration++;
+}
+
+
+#pragma mark - Key Table
+
+- (void)loadKeyTable:(NSString *)keyTableName fromBundle:(NSBundle *)bundle {
+    NSParameterAssert(keyTableName);
+    NSParameterAssert(bundle);
+    
+    // key tables are looked up the same way as style files
+    NSString *keyTablePath = [bundle pathForResource:keyTableName ofType:STOStyleKeyTableFileExtension];
+    if (keyTablePath == nil && bundle != [NSBundle mainBundle]) {
+        keyTablePath = [[NSBundle mainBundle] pathForResource:keyTableName ofType:STOStyleKeyTableFileExtension];
+    }
+    
+    NSData *keyTableData = (keyTablePath != nil ? [NSData dataWithContentsOfFile:keyTablePath] : nil);
+    NSAssert(keyTableData != nil, @"[ICSStyleManager]: Unable to find key table `%@`", keyTableName);
+    
+    ICSStyleKeyTable *keyTable = [[ICSStyleKeyTable alloc] initWithData:keyTableData];
+    NSAssert(keyTable != nil, @"[ICSStyleManager]: Invalid key table `%@`", keyTableName);
+    
+    self.keyTable = keyTable;
+    self.keyTableValues = nil;
+    
+#if defined(ICS_STYLE_MANAGER_LOG)
+    NSLog(@"[ICSStyleManager]: Key table `%@` loaded with %lu keys", keyTableName, (unsigned long)keyTable.keys.count);
+#endif
+}
+
+// Returns the value of a key found in the key table, or nil if the key is not
+// part of the table or hasn't been assigned a value
+- (id)keyTableValueForKey:(NSString *)key {
+    if (self.keyTableValues == nil) {
+        // a style has been loaded since the table has been filled
+        [self fillKeyTableValues];
+    }
+    
+    NSUInteger index = [self.keyTable indexOfKey:key];
+    if (index == NSNotFound) {
+        return nil;
+    }
+    
+    id value = self.keyTableValues[index];
+    return (value != [NSNull null] ? value : nil);
+}
+
+- (void)fillKeyTableValues {
+    NSArray *keys = self.keyTable.keys;
+    NSMutableArray *keyTableValues = [[NSMutableArray alloc] initWithCapacity:keys.count];
+    
+    for (NSString *key in keys) {
+        id value = (self.compactStyleDescriptor != nil ? [self.compactStyleDescriptor objectForKey:key] : self.styleDescriptor[key]);
+        [keyTableValues addObject:(value ?: [NSNull null])];
+    }
+    
+    self.keyTableValues = keyTableValues;
+}
+
+
+#pragma mark - Memory
+
+- (ICSStyleFootprint)footprint {
+    [self waitForDeferredLoading];
+    
+    ICSStyleFootprint footprint = {0};
+    
+    // objects shared by multiple keys (e.g. through variables) are counted once
+    NSHashTable *countedObjects = [[NSHashTable alloc] initWithOptions:NSPointerFunctionsObjectPointerPersonality capacity:0];
+    
+    if (self.compactStyleDescriptor != nil) {
+        [self.compactStyleDescriptor addToFootprint:&footprint countedObjects:countedObjects];
+    }
+    else {
+        STOStyleAddDictionaryToFootprint(self.styleDescriptor, &footprint, countedObjects);
+    }
+    
+    // values of the imported styles, kept for the styles importing them later
+    for (NSDictionary *importedStyleDescriptor in self.importedStyleDescriptors.objectEnumerator) {
+        STOStyleAddDictionaryToFootprint(importedStyleDescriptor, &footprint, countedObjects);
+    }
+    
+    if (self.keyTable != nil) {
+        [self.keyTable addToFootprint:&footprint];
+        
+        footprint.storage += STOStyleObjectFootprint(self.keyTableValues) + (self.keyTableValues.count * sizeof(id));
+        for (id value in self.keyTableValues) {
+            STOStyleAddValueToFootprint(value, &footprint, countedObjects);
+        }
+    }
+    
+    // fonts kept to be shared by the keys using them
+    footprint.storage += STOStyleObjectFootprint(self.fonts) + (self.fonts.count * 2 * sizeof(id))
+                       + STOStyleObjectFootprint(self.preferredFonts) + (self.preferredFonts.count * 2 * sizeof(id));
+    for (NSArray *fontKey in self.fonts) {
+        footprint.storage += STOStyleObjectFootprint(fontKey);
+        STOStyleAddValueToFootprint(self.fonts[fontKey], &footprint, countedObjects);
+    }
+    for (UIFont *font in self.preferredFonts.objectEnumerator) {
+        STOStyleAddValueToFootprint(font, &footprint, countedObjects);
+    }
+    
+    // account for the bitmaps of the images retained by the pattern image colors
+    // counted so far, i.e. the ones still assigned to a key
+    for (id value in countedObjects.allObjects) {
+        NSString *patternImageName = ([value isKindOfClass:[UIColor class]] ? [self.patternImageColorNames objectForKey:value] : nil);
+        UIImage *patternImage = (patternImageName != nil ? [self.patternImages objectForKey:patternImageName] : nil);
+        
+        if (patternImage != nil && ![countedObjects containsObject:patternImage]) {
+            [countedObjects addObject:patternImage];
+            footprint.images += STOStyleImageFootprint(patternImage);
+        }
+    }
+    
+    footprint.total = footprint.keys + footprint.numbers + footprint.geometricValues + footprint.colors
+                    + footprint.fonts + footprint.images + footprint.storage;
+    
+    return footprint;
+}
+
+- (void)compact {
+    [self waitForDeferredLoading];
+    
+    if (self.compactStyleDescriptor != nil) {
+        // nothing has been loaded since the last compaction
+        return;
+    }
+    
+    self.compactStyleDescriptor = [[ICSStyleCompactDescriptor alloc] initWithStyleDescriptor:self.styleDescriptor];
+    _styleDescriptor = [[NSMutableDictionary alloc] init];
+}
+
+- (void)expandCompactStyleDescriptor {
+    if (self.compactStyleDescriptor == nil) {
+        return;
+    }
+    
+    _styleDescriptor = [self.compactStyleDescriptor mutableStyleDescriptor];
+    self.compactStyleDescriptor = nil;
+}
+
+@end
+
+
+// -------------------------
+// NSString Category
+// -------------------------
+
+#pragma mark - Evaluate Numerical Expression
+
+@implementation NSString (ICSStyleManager)
+
+- (NSNumber *)sto_numberByEvaluatingStringWithStyleDescriptor:(NSDictionary *)styleDescriptor environment:(NSDictionary *)environment {
+    NSParameterAssert(styleDescriptor);
+    
+    // literal numbers (e.g. the ones written by a folded style) don't need to
+    // go through DDMathParser
+    NSNumber *literal = STOStyleNumberFromLiteral(self);
+    if (literal != nil) {
+        return literal;
+    }
+    
+    NSString *stringToEvaluate = self;
+    
+    while (YES) {
+        // build a regular expression to check for a variable match (e.g. `@varName`)
+        NSError *error = nil;
+        NSRegularExpression *expression = [[NSRegularExpression alloc] initWithPattern:STOStyleInnerVariablePattern options:0 error:&error];
+        NSAssert(error == nil, @"[ICSStyleManager]: Error building regular expression to evaluate number in string `%@`: %@", stringToEvaluate, error);
+        
+        // check for a variable match in the string
+        NSTextCheckingResult *match = [expression firstMatchInString:stringToEvaluate options:0 range:NSMakeRange(0, stringToEvaluate.length)];
+        if (match == nil || match.numberOfRanges <= 1) {
+            // no variables, evaluate the string using DDMathParser's numberByEvaluatingString
+            return [stringToEvaluate numberByEvaluatingString];
+        }
+        
+        // variable found, extract its name
+        NSRange matchRange = [match rangeAtIndex:1];
+        NSString *varName = [stringToEvaluate substringWithRange:matchRange];
+        
+        // obtain variable's value
+        NSNumber *n = ([varName hasPrefix:STOStyleEnvironmentPrefix]
+                       ? environment[[varName substringFromIndex:STOStyleEnvironmentPrefix.length]]
+                       : styleDescriptor[varName]);
+        NSAssert(n != nil, @"[ICSStyleManager]: Attempt to use undefined variable `%@` inside the numerical expression `%@`", varName, self);
+        NSAssert([n isKindOfClass:[NSNumber class]], @"[ICSStyleManager]: Attempt to use variable `%@` inside the numerical expression `%@`, but the variable's value is not a number", varName, self);
+        
+        // replace the variable with its number value in the string to evaluate
+        NSParameterAssert(matchRange.location > 0);
+        matchRange.location--, matchRange.length++; // also replace the '@' sign just before the variable name
+        stringToEvaluate = [stringToEvaluate stringByReplacingCharactersInRange:matchRange withString:[n stringValue]];
+        
+        // check for other variable matches
+    }
+}
+
+@end
+
+
+// -------------------------
+// Literals and Variables
+// -------------------------
+
+#pragma mark - Literals and Variables
+
+static NSNumber *STOStyleNumberFromLiteral(NSString *string) {
+    NSCParameterAssert(string);
+    
+    NSScanner *scanner = [[NSScanner alloc] initWithString:string];
+    double number;
+    
+    if ([scanner scanDouble:&number] && [scanner isAtEnd]) {
+        return @(number);
+    }
+    
+    return nil;
+}
+
+// Casting a number that doesn't fit into an integer type is undefined: numbers are
+// truncated toward zero, clamped to the range of the type, and NaN becomes 0
+static NSInteger STOStyleIntegerFromNumber(double number) {
+    if (isnan(number)) {
+        return 0;
+    }
+    if (number <= (double)NSIntegerMin) {
+        return NSIntegerMin;
+    }
+    if (number >= (double)NSIntegerMax) {
+        // NSIntegerMax isn't exactly representable, and is rounded up
+        return NSIntegerMax;
+    }
+    
+    return (NSInteger)number;
+}
+
+static NSUInteger STOStyleUnsignedIntegerFromNumber(double number) {
+    if (isnan(number) || number <= 0) {
+        return 0;
+    }
+    if (number >= (double)NSUIntegerMax) {
+        return NSUIntegerMax;
+    }
+    
+    return (NSUInteger)number;
+}
+
+static NSArray *STOStyleVariableNamesInString(NSString *string) {
+    NSCParameterAssert(string);
+    
+    NSError *error = nil;
+    NSRegularExpression *expression = [[NSRegularExpression alloc] initWithPattern:STOStyleInnerVariablePattern options:0 error:&error];
+    NSCAssert(error == nil, @"[ICSStyleManager]: Error building regular expression to find variables in string `%@`: %@", string, error);
+    
+    NSMutableArray *variableNames = [[NSMutableArray alloc] init];
+    for (NSTextCheckingResult *match in [expression matchesInString:string options:0 range:NSMakeRange(0, string.length)]) {
+        [variableNames addObject:[string substringWithRange:[match rangeAtIndex:1]]];
+    }
+    
+    return variableNames;
+}
+
+
+// -------------------------
+// Image Descriptor
+// -------------------------
+
+#pragma mark - Image Descriptor
+
+@implementation ICSStyleImageDescriptor
+@end
+
+
+// -------------------------
+// Dynamic Assignment
+// -------------------------
+
+#pragma mark - Dynamic Assignment
+
+@implementation ICSStyleDynamicAssignment
+@end
+
+
+// -------------------------
+// Assignment
+// -------------------------
+
+#pragma mark - Assignment
+
+@implementation ICSStyleAssignment
+@end
+
+
+// -------------------------
+// Deferred Loading
+// -------------------------
+
+#pragma mark - Deferred Loading
+
+@implementation ICSStyleDeferredLoading
+
+- (instancetype)init {
+    if ((self = [super init])) {
+        _condition = [[NSCondition alloc] init];
+        _evaluationLock = [[NSRecursiveLock alloc] init];
+        _postponedOperations = [[NSMutableArray alloc] init];
+        _pendingKeys = [[NSMutableSet alloc] init];
+    }
+    
+    return self;
+}
+
+@end
+
+
+// -------------------------
+// Compact Descriptor
+// -------------------------
+
+#pragma mark - Compact Descriptor
+
+// Entry of ICSStyleCompactDescriptor: the key is stored as a pair of indexes into
+// the shared tables of group prefixes and names, the value as an index into either
+// the scalars or the objects table, depending on its type
+typedef struct {
+    uint32_t prefix;
+    uint32_t name;
+    uint32_t value;
+    STOStyleCompactValueType type;
+} STOStyleCompactEntry;
+
+
+// Returns the number of scalars used to store a value of the given type
+static NSUInteger STOStyleCompactScalarCount(STOStyleCompactValueType type) {
+    switch (type) {
+        case STOStyleCompactValueTypeNumber:
+            return 1;
+        case STOStyleCompactValueTypePoint:
+        case STOStyleCompactValueTypeSize:
+            return 2;
+        case STOStyleCompactValueTypeRect:
+            return 4;
+        case STOStyleCompactValueTypeObject:
+            return 0;
+    }
+    
+    return 0;
+}
+
+
+// Stores the scalars of a numeric or geometric value (up to 4) and returns the
+// type of the value
+static STOStyleCompactValueType STOStyleCompactGetScalars(id value, double *scalars) {
+    if ([value isKindOfClass:[NSNumber class]]) {
+        scalars[0] = [value doubleValue];
+        return STOStyleCompactValueTypeNumber;
+    }
+    
+    if ([value isKindOfClass:[NSValue class]]) {
+        const char *objCType = [value objCType];
+        
+        if (strcmp(objCType, @encode(CGPoint)) == 0) {
+            CGPoint point = [value CGPointValue];
+            scalars[0] = point.x;
+            scalars[1] = point.y;
+            return STOStyleCompactValueTypePoint;
+        }
+        
+        if (strcmp(objCType, @encode(CGSize)) == 0) {
+            CGSize size = [value CGSizeValue];
+            scalars[0] = size.width;
+            scalars[1] = size.height;
+            return STOStyleCompactValueTypeSize;
+        }
+        
+        if (strcmp(objCType, @encode(CGRect)) == 0) {
+            CGRect rect = [value CGRectValue];
+            scalars[0] = rect.origin.x;
+            scalars[1] = rect.origin.y;
+            scalars[2] = rect.size.width;
+            scalars[3] = rect.size.height;
+            return STOStyleCompactValueTypeRect;
+        }
+    }
     
-    if (self.imageLoader != nil) {
-        // ask image loader for the image with the given name
-        image = [self.imageLoader styleManager:self imageNamed:imageName];
+    return STOStyleCompactValueTypeObject;
+}
+
+
+// Splits a key into the ranges of its group prefix (e.g. `tableView.header`)
+// and of its name (e.g. `height`)
+static void STOStyleSplitKey(NSString *key, NSRange *prefixRange, NSRange *nameRange) {
+    NSRange separatorRange = [key rangeOfString:STOStyleGroupSeparator options:(NSLiteralSearch | NSBackwardsSearch)];
+    
+    if (separatorRange.location == NSNotFound) {
+        *prefixRange = NSMakeRange(0, 0);
+        *nameRange = NSMakeRange(0, key.length);
     }
     else {
-        // no image loader, load the image with +[UIImage imageNamed:]
-        image = [UIImage imageNamed:imageName];
+        *prefixRange = NSMakeRange(0, separatorRange.location);
+        *nameRange = NSMakeRange(NSMaxRange(separatorRange), key.length - NSMaxRange(separatorRange));
+    }
+}
+
+
+@implementation ICSStyleCompactDescriptor {
+    // group prefixes and names of the keys, shared among all the entries
+    NSArray *_prefixes;
+    NSArray *_names;
+    // entries sorted by group prefix and name, so that they can be binary searched
+    STOStyleCompactEntry *_entries;
+    NSUInteger _entryCount;
+    // values that can't be stored unboxed
+    NSMutableArray *_objects;
+    double *_scalars;
+    NSUInteger _scalarCount;
+}
+
+- (instancetype)initWithStyleDescriptor:(NSDictionary *)styleDescriptor {
+    NSParameterAssert(styleDescriptor);
+    
+    if ((self = [super init])) {
+        NSArray *keys = [styleDescriptor.allKeys sortedArrayUsingComparator:^NSComparisonResult(NSString *key1, NSString *key2) {
+            NSRange prefixRange1, nameRange1, prefixRange2, nameRange2;
+            STOStyleSplitKey(key1, &prefixRange1, &nameRange1);
+            STOStyleSplitKey(key2, &prefixRange2, &nameRange2);
+            
+            NSComparisonResult result = [key1 compare:[key2 substringWithRange:prefixRange2] options:NSLiteralSearch range:prefixRange1];
+            if (result == NSOrderedSame) {
+                result = [key1 compare:[key2 substringWithRange:nameRange2] options:NSLiteralSearch range:nameRange1];
+            }
+            return result;
+        }];
+        
+        NSMutableArray *prefixes = [[NSMutableArray alloc] init];
+        NSMutableArray *names = [[NSMutableArray alloc] init];
+        NSMutableDictionary *nameIndexes = [[NSMutableDictionary alloc] init];
+        NSMutableArray *objects = [[NSMutableArray alloc] init];
+        
+        _entryCount = keys.count;
+        _entries = calloc(MAX(_entryCount, 1), sizeof(STOStyleCompactEntry));
+        // allocate room for the largest values, the table is shrunk to fit below
+        _scalars = calloc(MAX(_entryCount, 1) * 4, sizeof(double));
+        
+        for (NSUInteger i = 0; i < _entryCount; i++) {
+            NSString *key = keys[i];
+            STOStyleCompactEntry *entry = &_entries[i];
+            
+            NSRange prefixRange, nameRange;
+            STOStyleSplitKey(key, &prefixRange, &nameRange);
+            
+            // keys are sorted, so keys with the same group prefix are contiguous
+            NSString *prefix = [key substringWithRange:prefixRange];
+            if (![prefixes.lastObject isEqualToString:prefix]) {
+                [prefixes addObject:prefix];
+            }
+            entry->prefix = (uint32_t)(prefixes.count - 1);
+            
+            NSString *name = [key substringWithRange:nameRange];
+            NSNumber *nameIndex = nameIndexes[name];
+            if (nameIndex == nil) {
+                nameIndex = @(names.count);
+                [names addObject:name];
+                nameIndexes[name] = nameIndex;
+            }
+            entry->name = [nameIndex unsignedIntValue];
+            
+            // store the value unboxed whenever possible
+            id value = styleDescriptor[key];
+            entry->type = STOStyleCompactGetScalars(value, &_scalars[_scalarCount]);
+            
+            if (entry->type == STOStyleCompactValueTypeObject) {
+                entry->value = (uint32_t)objects.count;
+                [objects addObject:value];
+            }
+            else {
+                entry->value = (uint32_t)_scalarCount;
+                _scalarCount += STOStyleCompactScalarCount(entry->type);
+            }
+        }
+        
+        _scalars = realloc(_scalars, MAX(_scalarCount, 1) * sizeof(double));
+        _prefixes = [prefixes copy];
+        _names = [names copy];
+        _objects = objects;
     }
     
-    NSAssert(image != nil, @"[ICSStyleManager]: Unable to load image named `%@`", imageName);
-    return image;
+    return self;
+}
+
+- (void)dealloc {
+    free(_entries);
+    free(_scalars);
+}
+
+- (const STOStyleCompactEntry *)entryForKey:(NSString *)key {
+    NSParameterAssert(key);
+    
+    NSRange prefixRange, nameRange;
+    STOStyleSplitKey(key, &prefixRange, &nameRange);
+    
+    // binary search comparing the ranges of the key against the shared
+    // prefixes and names, without building any substring
+    NSUInteger low = 0;
+    NSUInteger high = _entryCount;
+    
+    while (low < high) {
+        NSUInteger middle = low + (high - low) / 2;
+        const STOStyleCompactEntry *entry = &_entries[middle];
+        
+        NSComparisonResult result = [key compare:_prefixes[entry->prefix] options:NSLiteralSearch range:prefixRange];
+        if (result == NSOrderedSame) {
+            result = [key compare:_names[entry->name] options:NSLiteralSearch range:nameRange];
+        }
+        
+        if (result == NSOrderedSame) {
+            return entry;
+        }
+        else if (result == NSOrderedAscending) {
+            high = middle;
+        }
+        else {
+            low = middle + 1;
+        }
+    }
+    
+    return NULL;
+}
+
+- (id)objectForEntry:(const STOStyleCompactEntry *)entry {
+    const double *scalars = &_scalars[entry->value];
+    
+    switch (entry->type) {
+        case STOStyleCompactValueTypeNumber:
+            return @(scalars[0]);
+        case STOStyleCompactValueTypePoint:
+            return [NSValue valueWithCGPoint:CGPointMake(scalars[0], scalars[1])];
+        case STOStyleCompactValueTypeSize:
+            return [NSValue valueWithCGSize:CGSizeMake(scalars[0], scalars[1])];
+        case STOStyleCompactValueTypeRect:
+            return [NSValue valueWithCGRect:CGRectMake(scalars[0], scalars[1], scalars[2], scalars[3])];
+        case STOStyleCompactValueTypeObject:
+            return _objects[entry->value];
+    }
+    
+    return nil;
+}
+
+- (id)objectForKey:(NSString *)key {
+    const STOStyleCompactEntry *entry = [self entryForKey:key];
+    return (entry != NULL ? [self objectForEntry:entry] : nil);
+}
+
+- (BOOL)getScalars:(double *)scalars ofType:(STOStyleCompactValueType)type forKey:(NSString *)key {
+    NSParameterAssert(scalars);
+    
+    NSUInteger count = STOStyleCompactScalarCount(type);
+    const STOStyleCompactEntry *entry = [self entryForKey:key];
+    
+    if (entry == NULL || entry->type != type) {
+        memset(scalars, 0, count * sizeof(double));
+        return NO;
+    }
+    
+    memcpy(scalars, &_scalars[entry->value], count * sizeof(double));
+    return YES;
+}
+
+- (BOOL)replaceObject:(id)object forKey:(NSString *)key {
+    NSParameterAssert(object);
+    
+    STOStyleCompactEntry *entry = (STOStyleCompactEntry *)[self entryForKey:key];
+    double scalars[4];
+    
+    // values can only be replaced in place by values of the same type
+    if (entry == NULL || STOStyleCompactGetScalars(object, scalars) != entry->type) {
+        return NO;
+    }
+    
+    if (entry->type == STOStyleCompactValueTypeObject) {
+        _objects[entry->value] = object;
+    }
+    else {
+        memcpy(&_scalars[entry->value], scalars, STOStyleCompactScalarCount(entry->type) * sizeof(double));
+    }
+    
+    return YES;
+}
+
+- (void)replaceObjectsUsingBlock:(id (^)(id object))block {
+    NSParameterAssert(block);
+    
+    for (NSUInteger i = 0; i < _objects.count; i++) {
+        id replacement = block(_objects[i]);
+        if (replacement != nil) {
+            _objects[i] = replacement;
+        }
+    }
+}
+
+- (void)enumerateObjectsUsingBlock:(void (^)(NSString *key, id object))block {
+    NSParameterAssert(block);
+    
+    // only the values stored as objects are enumerated
+    for (NSUInteger i = 0; i < _entryCount; i++) {
+        const STOStyleCompactEntry *entry = &_entries[i];
+        if (entry->type == STOStyleCompactValueTypeObject) {
+            block([self keyForEntry:entry], _objects[entry->value]);
+        }
+    }
+}
+
+- (NSArray *)allKeys {
+    NSMutableArray *keys = [[NSMutableArray alloc] initWithCapacity:_entryCount];
+    
+    for (NSUInteger i = 0; i < _entryCount; i++) {
+        [keys addObject:[self keyForEntry:&_entries[i]]];
+    }
+    
+    return keys;
+}
+
+- (NSString *)keyForEntry:(const STOStyleCompactEntry *)entry {
+    NSString *prefix = _prefixes[entry->prefix];
+    NSString *name = _names[entry->name];
+    return (prefix.length > 0 ? [NSString stringWithFormat:@"%@%@%@", prefix, STOStyleGroupSeparator, name] : name);
+}
+
+- (NSMutableDictionary *)mutableStyleDescriptor {
+    NSMutableDictionary *styleDescriptor = [[NSMutableDictionary alloc] initWithCapacity:_entryCount];
+    
+    for (NSUInteger i = 0; i < _entryCount; i++) {
+        const STOStyleCompactEntry *entry = &_entries[i];
+        styleDescriptor[[self keyForEntry:entry]] = [self objectForEntry:entry];
+    }
+    
+    return styleDescriptor;
+}
+
+- (void)addToFootprint:(ICSStyleFootprint *)footprint countedObjects:(NSHashTable *)countedObjects {
+    NSParameterAssert(footprint);
+    NSParameterAssert(countedObjects);
+    
+    for (NSString *prefix in _prefixes) {
+        footprint->keys += STOStyleObjectFootprint(prefix);
+    }
+    
+    for (NSString *name in _names) {
+        footprint->keys += STOStyleObjectFootprint(name);
+    }
+    
+    footprint->storage += STOStyleObjectFootprint(_prefixes) + STOStyleObjectFootprint(_names) + STOStyleObjectFootprint(_objects)
+                        + (_entryCount * sizeof(STOStyleCompactEntry));
+    
+    for (NSUInteger i = 0; i < _entryCount; i++) {
+        const STOStyleCompactEntry *entry = &_entries[i];
+        size_t scalarsSize = STOStyleCompactScalarCount(entry->type) * sizeof(double);
+        
+        switch (entry->type) {
+            case STOStyleCompactValueTypeNumber:
+                footprint->numbers += scalarsSize;
+                break;
+            case STOStyleCompactValueTypePoint:
+            case STOStyleCompactValueTypeSize:
+            case STOStyleCompactValueTypeRect:
+                footprint->geometricValues += scalarsSize;
+                break;
+            case STOStyleCompactValueTypeObject:
+                STOStyleAddValueToFootprint(_objects[entry->value], footprint, countedObjects);
+                break;
+        }
+    }
 }
 
 @end
 
 
 // -------------------------
-// NSString Category
+// Value Batch
 // -------------------------
 
-#pragma mark - Evaluate Numerical Expression
+#pragma mark - Value Batch
+
+// Field of the caller's struct filled by ICSStyleValueBatch
+typedef struct {
+    ICSStyleValueType type;
+    size_t offset;
+    size_t length;
+} STOStyleValueBatchField;
+
+
+// Returns the size of a struct field holding a value of the given type
+static size_t STOStyleValueTypeLength(ICSStyleValueType type) {
+    switch (type) {
+        case ICSStyleValueTypeFloat:
+            return sizeof(CGFloat);
+        case ICSStyleValueTypeInteger:
+            return sizeof(NSInteger);
+        case ICSStyleValueTypeUnsignedInteger:
+            return sizeof(NSUInteger);
+        case ICSStyleValueTypeTimeInterval:
+            return sizeof(NSTimeInterval);
+        case ICSStyleValueTypeRect:
+            return sizeof(CGRect);
+        case ICSStyleValueTypeSize:
+            return sizeof(CGSize);
+        case ICSStyleValueTypePoint:
+            return sizeof(CGPoint);
+        case ICSStyleValueTypeFont:
+        case ICSStyleValueTypeColor:
+        case ICSStyleValueTypeImage:
+            return sizeof(id);
+    }
+    
+    return 0;
+}
 
-@implementation NSString (ICSStyleManager)
 
-- (NSNumber *)sto_numberByEvaluatingStringWithStyleDescriptor:(NSDictionary *)styleDescriptor {
-    NSParameterAssert(styleDescriptor);
-    
-    NSString *stringToEvaluate = self;
+@implementation ICSStyleValueBatch {
+    ICSStyleManager *_styleManager;
+    NSArray *_keys;
+    STOStyleValueBatchField *_fields;
+    NSUInteger _fieldCount;
+    // resolved values, laid out as in the caller's struct
+    uint8_t *_values;
+    // resolved object values, retained on behalf of the caller's struct
+    NSArray *_objects;
+    NSUInteger _styleGeneration;
+}
+
+- (instancetype)initWithStyleManager:(ICSStyleManager *)styleManager requests:(const ICSStyleValueRequest *)requests count:(NSUInteger)count {
+    NSParameterAssert(styleManager);
     
-    while (YES) {
-        // build a regular expression to check for a variable match (e.g. `@varName`)
-        NSError *error = nil;
-        NSRegularExpression *expression = [[NSRegularExpression alloc] initWithPattern:STOStyleInnerVariablePattern options:0 error:&error];
-        NSAssert(error == nil, @"[ICSStyleManager]: Error building regular expression to evaluate number in string `%@`: %@", stringToEvaluate, error);
+    if ((self = [super init])) {
+        _styleManager = styleManager;
+        _fieldCount = count;
+        _fields = calloc(MAX(count, 1), sizeof(STOStyleValueBatchField));
         
-        // check for a variable match in the string
-        NSTextCheckingResult *match = [expression firstMatchInString:stringToEvaluate options:0 range:NSMakeRange(0, stringToEvaluate.length)];
-        if (match == nil || match.numberOfRanges <= 1) {
-            // no variables, evaluate the string using DDMathParser's numberByEvaluatingString
-            return [stringToEvaluate numberByEvaluatingString];
+        NSMutableArray *keys = [[NSMutableArray alloc] initWithCapacity:count];
+        size_t valuesLength = 0;
+        
+        for (NSUInteger i = 0; i < count; i++) {
+            NSParameterAssert(requests[i].key);
+            [keys addObject:[requests[i].key copy]];
+            
+            _fields[i].type = requests[i].type;
+            _fields[i].offset = requests[i].offset;
+            _fields[i].length = STOStyleValueTypeLength(requests[i].type);
+            valuesLength = MAX(valuesLength, _fields[i].offset + _fields[i].length);
         }
         
-        // variable found, extract its name
-        NSRange matchRange = [match rangeAtIndex:1];
-        NSString *varName = [stringToEvaluate substringWithRange:matchRange];
+        _keys = [keys copy];
+        _values = calloc(MAX(valuesLength, 1), 1);
         
-        // obtain variable's value
-        NSNumber *n = styleDescriptor[varName];
-        NSParameterAssert(n);
-        NSAssert([n isKindOfClass:[NSNumber class]], @"[ICSStyleManager]: Attempt to use variable `%@` inside the numerical expression `%@`, but the variable's value is not a number", varName, self);
+        // resolve the values right away, so that all the keys are checked
+        // against the loaded style when the batch is created
+        [self resolveValues];
+    }
+    
+    return self;
+}
+
+- (void)dealloc {
+    free(_fields);
+    free(_values);
+}
+
+- (void)resolveValues {
+    NSMutableArray *objects = [[NSMutableArray alloc] init];
+    
+    for (NSUInteger i = 0; i < _fieldCount; i++) {
+        NSString *key = _keys[i];
+        uint8_t *value = _values + _fields[i].offset;
+        id object = nil;
+        BOOL isObject = YES;
         
-        // replace the variable with its number value in the string to evaluate
-        NSParameterAssert(matchRange.location > 0);
-        matchRange.location--, matchRange.length++; // also replace the '@' sign just before the variable name
-        stringToEvaluate = [stringToEvaluate stringByReplacingCharactersInRange:matchRange withString:[n stringValue]];
+        switch (_fields[i].type) {
+            case ICSStyleValueTypeFloat:
+                *(CGFloat *)value = [_styleManager floatForKey:key];
+                isObject = NO;
+                break;
+            case ICSStyleValueTypeInteger:
+                *(NSInteger *)value = [_styleManager integerForKey:key];
+                isObject = NO;
+                break;
+            case ICSStyleValueTypeUnsignedInteger:
+                *(NSUInteger *)value = [_styleManager unsignedIntegerForKey:key];
+                isObject = NO;
+                break;
+            case ICSStyleValueTypeTimeInterval:
+                *(NSTimeInterval *)value = [_styleManager timeIntervalForKey:key];
+                isObject = NO;
+                break;
+            case ICSStyleValueTypeRect:
+                *(CGRect *)value = [_styleManager rectForKey:key];
+                isObject = NO;
+                break;
+            case ICSStyleValueTypeSize:
+                *(CGSize *)value = [_styleManager sizeForKey:key];
+                isObject = NO;
+                break;
+            case ICSStyleValueTypePoint:
+                *(CGPoint *)value = [_styleManager pointForKey:key];
+                isObject = NO;
+                break;
+            case ICSStyleValueTypeFont:
+                object = [_styleManager fontForKey:key];
+                break;
+            case ICSStyleValueTypeColor:
+                object = [_styleManager colorForKey:key];
+                break;
+            case ICSStyleValueTypeImage:
+                object = [_styleManager imageForKey:key];
+                break;
+        }
         
-        // check for other variable matches
+        if (isObject) {
+            // the caller's struct holds an unretained reference, the batch keeps the object alive
+            *(__unsafe_unretained id *)value = object;
+            if (object != nil) {
+                [objects addObject:object];
+            }
+        }
+    }
+    
+    _objects = [objects copy];
+    _styleGeneration = _styleManager.styleGeneration;
+}
+
+- (void)getValues:(void *)values {
+    NSParameterAssert(values);
+    
+    if (_styleGeneration != _styleManager.styleGeneration) {
+        // the style changed since the values have been resolved
+        [self resolveValues];
+    }
+    
+    uint8_t *fields = values;
+    for (NSUInteger i = 0; i < _fieldCount; i++) {
+        memcpy(fields + _fields[i].offset, _values + _fields[i].offset, _fields[i].length);
     }
 }
 
@@ -596,10 +2626,281 @@ static NSString *const STOStylePreferredFontStyleCaption2 = @"Caption2";
 
 
 // -------------------------
-// Image Descriptor
+// Key Table
 // -------------------------
 
-#pragma mark - Image Descriptor
+#pragma mark - Key Table
+
+// Layout of the data of a key table: the header is followed by the displacements of the
+// buckets (int32_t each), by the offsets of the keys sorted by slot (uint32_t each) and by
+// the NUL terminated UTF-8 keys. All the integers are stored little endian. Key tables
+// are written by Tools/generate_key_table.py, which must be kept in sync with this layout
+// and with the hash functions below
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t count;
+    uint32_t bucketCount;
+} STOStyleKeyTableHeader;
+
+static const char STOStyleKeyTableMagic[4] = {'I', 'C', 'S', 'K'};
+static const uint32_t STOStyleKeyTableVersion = 1;
+
+// Longest key (in UTF-8 bytes) that can be looked up in a key table, longer keys
+// are looked up in the regular storage
+static const size_t STOStyleKeyTableMaxKeyLength = 256;
+
+// 64-bit FNV-1a hash of the bytes of a key: the upper half selects the bucket, the
+// lower half is mixed with the displacement of the bucket to select the slot
+static uint64_t STOStyleKeyTableHash(const char *bytes, size_t length) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (uint8_t)bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static uint32_t STOStyleKeyTableSlot(uint64_t hash, int32_t displacement, uint32_t count) {
+    if (displacement < 0) {
+        // buckets with a single key store the slot directly
+        return (uint32_t)(-displacement - 1);
+    }
+    
+    // MurmurHash3 finalizer
+    uint32_t slot = (uint32_t)hash ^ (uint32_t)displacement;
+    slot ^= slot >> 16;
+    slot *= 0x85ebca6b;
+    slot ^= slot >> 13;
+    slot *= 0xc2b2ae35;
+    slot ^= slot >> 16;
+    return slot % count;
+}
+
+@implementation ICSStyleKeyTable {
+    NSData *_data;
+    uint32_t _count;
+    uint32_t _bucketCount;
+    const int32_t *_displacements;
+    const uint32_t *_offsets;
+    const char *_strings;
+    size_t _stringsLength;
+}
+
+- (instancetype)initWithData:(NSData *)data {
+    NSParameterAssert(data);
+    
+    if ((self = [super init])) {
+        STOStyleKeyTableHeader header;
+        if (data.length < sizeof(header)) {
+            return nil;
+        }
+        
+        [data getBytes:&header length:sizeof(header)];
+        _count = CFSwapInt32LittleToHost(header.count);
+        _bucketCount = CFSwapInt32LittleToHost(header.bucketCount);
+        
+        if (memcmp(header.magic, STOStyleKeyTableMagic, sizeof(header.magic)) != 0
+                || CFSwapInt32LittleToHost(header.version) != STOStyleKeyTableVersion
+                || _bucketCount == 0) {
+            return nil;
+        }
+        
+        size_t tablesLength = sizeof(header) + (_bucketCount * sizeof(int32_t)) + (_count * sizeof(uint32_t));
+        if (data.length < tablesLength) {
+            return nil;
+        }
+        
+        // the tables are used in place (iOS devices are little endian)
+        _data = [data copy];
+        const uint8_t *bytes = _data.bytes;
+        _displacements = (const int32_t *)(bytes + sizeof(header));
+        _offsets = (const uint32_t *)(bytes + sizeof(header) + (_bucketCount * sizeof(int32_t)));
+        _strings = (const char *)(bytes + tablesLength);
+        _stringsLength = _data.length - tablesLength;
+        
+        NSMutableArray *keys = [[NSMutableArray alloc] initWithCapacity:_count];
+        for (uint32_t i = 0; i < _count; i++) {
+            if (_offsets[i] >= _stringsLength || memchr(_strings + _offsets[i], '\0', _stringsLength - _offsets[i]) == NULL) {
+                return nil;
+            }
+            [keys addObject:@(_strings + _offsets[i])];
+        }
+        _keys = [keys copy];
+    }
+    
+    return self;
+}
+
+- (void)addToFootprint:(ICSStyleFootprint *)footprint {
+    NSParameterAssert(footprint);
+    
+    footprint->storage += STOStyleObjectFootprint(_data) + _data.length + STOStyleObjectFootprint(_keys) + (_keys.count * sizeof(id));
+    
+    for (NSString *key in _keys) {
+        footprint->keys += STOStyleObjectFootprint(key);
+    }
+}
+
+- (NSUInteger)indexOfKey:(NSString *)key {
+    if (_count == 0) {
+        return NSNotFound;
+    }
+    
+    char buffer[STOStyleKeyTableMaxKeyLength];
+    const char *bytes = CFStringGetCStringPtr((__bridge CFStringRef)key, kCFStringEncodingUTF8);
+    if (bytes == NULL) {
+        if (![key getCString:buffer maxLength:sizeof(buffer) encoding:NSUTF8StringEncoding]) {
+            return NSNotFound;
+        }
+        bytes = buffer;
+    }
+    
+    uint64_t hash = STOStyleKeyTableHash(bytes, strlen(bytes));
+    int32_t displacement = _displacements[(hash >> 32) % _bucketCount];
+    uint32_t slot = STOStyleKeyTableSlot(hash, displacement, _count);
+    
+    if (slot >= _count) {
+        return NSNotFound;
+    }
+    
+    // the only string comparison of the lookup
+    return (strcmp(_strings + _offsets[slot], bytes) == 0 ? slot : NSNotFound);
+}
 
-@implementation ICSStyleImageDescriptor
 @end
+
+
+// -------------------------
+// Dictionary Functions
+// -------------------------
+
+#pragma mark - Dictionary Functions
+
+static void STOStyleReplaceObjectsInDictionary(NSMutableDictionary *dictionary, id (^block)(id object)) {
+    NSCParameterAssert(dictionary);
+    NSCParameterAssert(block);
+    
+    NSMutableDictionary *replacements = [[NSMutableDictionary alloc] init];
+    
+    // the dictionary can't be mutated while being enumerated
+    [dictionary enumerateKeysAndObjectsUsingBlock:^(id key, id object, BOOL *stop) {
+        id replacement = block(object);
+        if (replacement != nil) {
+            replacements[key] = replacement;
+        }
+    }];
+    
+    [dictionary addEntriesFromDictionary:replacements];
+}
+
+
+// -------------------------
+// Image Functions
+// -------------------------
+
+#pragma mark - Image Functions
+
+static UIImage *STOStyleDecodedImage(UIImage *image) {
+    if (image == nil || image.images != nil) {
+        // animated images are left as they are
+        return image;
+    }
+    
+    UIImage *decodedImage = nil;
+    
+    if (@available(iOS 15.0, *)) {
+        // decoded by UIKit in the format best suited to the screen
+        decodedImage = [image imageByPreparingForDisplay];
+    }
+    else if (@available(iOS 10.0, *)) {
+        // drawing the image decodes it once and for all, and the renderer picks a wide
+        // color format on screens supporting it
+        UIGraphicsImageRendererFormat *format = [UIGraphicsImageRendererFormat defaultFormat];
+        format.scale = image.scale;
+        UIGraphicsImageRenderer *renderer = [[UIGraphicsImageRenderer alloc] initWithSize:image.size format:format];
+        decodedImage = [renderer imageWithActions:^(UIGraphicsImageRendererContext *context) {
+            [image drawAtPoint:CGPointZero];
+        }];
+    }
+    
+    if (decodedImage == nil || decodedImage == image) {
+        return image;
+    }
+    
+    // keep the attributes of the original image that the decoded bitmap doesn't carry
+    decodedImage = [decodedImage imageWithRenderingMode:image.renderingMode];
+    
+    if (image.resizingMode != UIImageResizingModeTile || !UIEdgeInsetsEqualToEdgeInsets(image.capInsets, UIEdgeInsetsZero)) {
+        // slicing of asset catalog images
+        decodedImage = [decodedImage resizableImageWithCapInsets:image.capInsets resizingMode:image.resizingMode];
+    }
+    
+    if (!UIEdgeInsetsEqualToEdgeInsets(image.alignmentRectInsets, UIEdgeInsetsZero)) {
+        decodedImage = [decodedImage imageWithAlignmentRectInsets:image.alignmentRectInsets];
+    }
+    
+    return decodedImage;
+}
+
+
+// -------------------------
+// Footprint Functions
+// -------------------------
+
+#pragma mark - Footprint Functions
+
+static size_t STOStyleObjectFootprint(id object) {
+    return (object != nil ? malloc_size((__bridge const void *)object) : 0);
+}
+
+static size_t STOStyleImageFootprint(UIImage *image) {
+    CGImageRef cgImage = image.CGImage;
+    return STOStyleObjectFootprint(image) + (CGImageGetBytesPerRow(cgImage) * CGImageGetHeight(cgImage));
+}
+
+static void STOStyleAddDictionaryToFootprint(NSDictionary *dictionary, ICSStyleFootprint *footprint, NSHashTable *countedObjects) {
+    // estimate the hash table of the dictionary as a key and a value pointer per entry
+    footprint->storage += STOStyleObjectFootprint(dictionary) + (dictionary.count * 2 * sizeof(id));
+    
+    for (NSString *key in dictionary) {
+        // keys are shared by the dictionaries the values have been copied into
+        if (![countedObjects containsObject:key]) {
+            [countedObjects addObject:key];
+            footprint->keys += STOStyleObjectFootprint(key);
+        }
+        
+        STOStyleAddValueToFootprint(dictionary[key], footprint, countedObjects);
+    }
+}
+
+static void STOStyleAddValueToFootprint(id value, ICSStyleFootprint *footprint, NSHashTable *countedObjects) {
+    if (value == nil || [countedObjects containsObject:value]) {
+        return;
+    }
+    
+    [countedObjects addObject:value];
+    size_t size = STOStyleObjectFootprint(value);
+    
+    if ([value isKindOfClass:[NSNumber class]]) {
+        footprint->numbers += size;
+    }
+    else if ([value isKindOfClass:[NSValue class]]) {
+        footprint->geometricValues += size;
+    }
+    else if ([value isKindOfClass:[UIColor class]]) {
+        footprint->colors += size;
+    }
+    else if ([value isKindOfClass:[UIFont class]]) {
+        footprint->fonts += size;
+    }
+    else if ([value isKindOfClass:[ICSStyleImageDescriptor class]]) {
+        ICSStyleImageDescriptor *imageDescriptor = value;
+        footprint->images += size + STOStyleObjectFootprint(imageDescriptor.name) + STOStyleObjectFootprint(imageDescriptor.capInsets);
+        
+        if (imageDescriptor.decodedImage != nil) {
+            // account for the bitmap of the prefetched image
+            footprint->images += STOStyleImageFootprint(imageDescriptor.decodedImage);
+        }
+    }
+}
@@ -0,0 +1,369 @@
+#!/usr/bin/env python3
+#
+#  fold_style.py
+#  ICSStyleManager
+#
+#  Copyright (c) 2014 ice cream studios s.r.l. - http://icecreamstudios.com
+#
+#  Permission is hereby granted, free of charge, to any person obtaining a copy
+#  of this software and associated documentation files (the "Software"), to deal
+#  in the Software without restriction, including without limitation the rights
+#  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+#  copies of the Software, and to permit persons to whom the Software is
+#  furnished to do so, subject to the following conditions:
+#
+#  The above copyright notice and this permission notice shall be included in
+#  all copies or substantial portions of the Software.
+#
+#  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+#  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+#  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+#  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+#  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+#  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+#  THE SOFTWARE.
+#
+
+"""Folds the numerical expressions of one or more style files.
+
+Each numerical expression whose inputs are all constants is replaced with its
+value (e.g. `#(100 / 2.5)` becomes `#(40)`), so that it doesn't need to be
+evaluated when the style is loaded. An expression is folded when all the
+variables it refers to have been assigned constant numeric values in the same
+style file or in the styles it imports. Expressions referring to keys defined
+by other styles or to environment values are left untouched, and so are the
+expressions using anything but numbers, variables, parentheses and the four
+arithmetic operators, which are left to DDMathParser.
+
+Usage:
+
+    fold_style.py Example.style Override-Example.style -o Folded
+
+The folded texts of the given styles, and of the styles they import, are
+written into the output directory with the same file names. Only the folded
+values are rewritten: the rest of the text, including comments and line
+terminators, is copied as it is. Each imported style is folded on its own,
+since it is evaluated on its own when loaded. Imported styles are looked up
+next to the style importing them, then in the directories passed with -I.
+
+The script is meant to be run by a build phase, writing the folded styles into
+the resources of the app in place of the original ones:
+
+    python3 "$SRCROOT/../Tools/fold_style.py" Example.style \\
+        -o "$TARGET_BUILD_DIR/$UNLOCALIZED_RESOURCES_FOLDER_PATH"
+"""
+
+import argparse
+import os
+import re
+import sys
+
+
+# The following definitions mirror the ones of ICSStyleManager.m
+
+STYLE_FILE_EXTENSION = ".style"
+STYLE_COMMENT_PREFIX = "//"
+STYLE_GROUP_SEPARATOR = "."
+
+STYLE_ASSIGNMENT_PATTERN = re.compile(r"\A([\w|\d|\.]*)\s*=\s*(.*)\Z")
+STYLE_VARIABLE_PATTERN = re.compile(r"\A@(\$?[\w|\d|\.]*)\Z")
+STYLE_INNER_VARIABLE_PATTERN = re.compile(r"@(\$?[\w|\d|\.]*)")
+STYLE_NUMBER_PATTERN = re.compile(r"\A#\s*\((.*)\)\Z")
+STYLE_RECT_PATTERN = re.compile(r"\AR\s*\(\s*(.*)\s*,\s*(.*)\s*,\s*(.*)\s*,\s*(.*)\s*\)\Z")
+STYLE_POINT_PATTERN = re.compile(r"\AP\s*\(\s*(.*)\s*,\s*(.*)\s*\)\Z")
+STYLE_SIZE_PATTERN = re.compile(r"\AS\s*\(\s*(.*)\s*,\s*(.*)\s*\)\Z")
+STYLE_RESIZABLE_IMAGE_PATTERN = re.compile(r"\AIMAGE\s*\(\s*([\w.]*)\s*,\s*(.*)\s*,\s*(.*)\s*,\s*(.*)\s*,\s*(.*)\s*\)\Z")
+STYLE_OPEN_GROUP_PATTERN = re.compile(r"\A([\w|\d|\.]*)\s*\{\Z")
+STYLE_CLOSE_GROUP_PATTERN = re.compile(r"\A\}\Z")
+STYLE_IMPORT_PATTERN = re.compile(r"\A@import\s+\"([\w\-.]*)\"\Z")
+
+# Values holding numerical expressions, tested in the same order as when a
+# style is loaded, along with the format of their folded text
+FOLDABLE_VALUES = [
+    (STYLE_NUMBER_PATTERN, "#(%s)"),
+    (STYLE_RECT_PATTERN, "R(%s)"),
+    (STYLE_POINT_PATTERN, "P(%s)"),
+    (STYLE_SIZE_PATTERN, "S(%s)"),
+    (STYLE_RESIZABLE_IMAGE_PATTERN, "IMAGE(%s)"),
+]
+
+# Numbers written as literals, read by the style manager without DDMathParser
+NUMBER_LITERAL_PATTERN = re.compile(r"\A\s*[-+]?(\d+\.?\d*|\.\d+)([eE][-+]?\d+)?\s*\Z")
+
+# Tokens of the expressions that can be folded
+EXPRESSION_TOKEN_PATTERN = re.compile(r"\s*(?:(\d+\.?\d*(?:[eE][-+]?\d+)?|\.\d+(?:[eE][-+]?\d+)?)|([-+*/()]))")
+
+
+class ExpressionError(Exception):
+    """Raised for the expressions that are left to DDMathParser."""
+
+
+def number_from_literal(string):
+    if NUMBER_LITERAL_PATTERN.match(string) is None:
+        return None
+    return float(string)
+
+
+def literal_from_number(number):
+    # use the shortest representation that is parsed back into the same value
+    for precision in range(15, 18):
+        literal = "%.*g" % (precision, number)
+        if float(literal) == number:
+            break
+    return literal
+
+
+def tokens_of_expression(expression):
+    tokens = []
+    position = 0
+    expression = expression.rstrip()
+
+    while position < len(expression):
+        match = EXPRESSION_TOKEN_PATTERN.match(expression, position)
+        if match is None:
+            raise ExpressionError(expression)
+        tokens.append(float(match.group(1)) if match.group(1) is not None else match.group(2))
+        position = match.end()
+
+    return tokens
+
+
+def evaluate_expression(expression):
+    """Evaluates an expression made of numbers, parentheses and the four
+    arithmetic operators, with the usual precedence."""
+    tokens = tokens_of_expression(expression)
+    position = 0
+
+    def peek():
+        return tokens[position] if position < len(tokens) else None
+
+    def take():
+        nonlocal position
+        token = peek()
+        if token is None:
+            raise ExpressionError(expression)
+        position += 1
+        return token
+
+    def factor():
+        token = take()
+        if token in ("-", "+"):
+            value = factor()
+            return -value if token == "-" else value
+        if token == "(":
+            value = sum_of_terms()
+            if take() != ")":
+                raise ExpressionError(expression)
+            return value
+        if isinstance(token, float):
+            return token
+        raise ExpressionError(expression)
+
+    def term():
+        value = factor()
+        while peek() in ("*", "/"):
+            if take() == "*":
+                value *= factor()
+            else:
+                divisor = factor()
+                if divisor == 0:
+                    raise ExpressionError(expression)
+                value /= divisor
+        return value
+
+    def sum_of_terms():
+        value = term()
+        while peek() in ("+", "-"):
+            value = value + term() if take() == "+" else value - term()
+        return value
+
+    value = sum_of_terms()
+    if position != len(tokens):
+        raise ExpressionError(expression)
+    return value
+
+
+def folded_expression(expression, constants, report):
+    """Returns the value of the expression written as a literal, or None if the
+    expression can't be folded."""
+    if number_from_literal(expression) is not None:
+        # already a plain number
+        return None
+
+    report["expressions"] += 1
+
+    def constant_of_variable(match):
+        constant = constants.get(match.group(1))
+        if constant is None:
+            # the expression depends on a value that is only known when loading the style
+            raise ExpressionError(expression)
+        return "(%s)" % literal_from_number(constant)
+
+    try:
+        number = evaluate_expression(STYLE_INNER_VARIABLE_PATTERN.sub(constant_of_variable, expression))
+    except (ExpressionError, OverflowError):
+        return None
+
+    if number != number or number in (float("inf"), float("-inf")):
+        return None
+
+    report["folded_expressions"] += 1
+    return literal_from_number(number)
+
+
+def folded_value(value, constants, report):
+    """Returns the value with its numerical expressions folded, or the value
+    itself if there is nothing to fold."""
+    if STYLE_VARIABLE_PATTERN.match(value):
+        return value
+
+    for pattern, value_format in FOLDABLE_VALUES:
+        match = pattern.match(value)
+        if match:
+            break
+    else:
+        # colors, fonts and other images don't contain numerical expressions
+        return value
+
+    expressions = [expression.strip() for expression in match.groups()]
+    folded_expressions = []
+
+    if pattern is STYLE_RESIZABLE_IMAGE_PATTERN:
+        folded_expressions.append(expressions.pop(0))
+
+    folded = False
+    for expression in expressions:
+        folded_text = folded_expression(expression, constants, report)
+        folded = folded or folded_text is not None
+        folded_expressions.append(folded_text if folded_text is not None else expression)
+
+    if not folded:
+        return value
+
+    return value_format % ", ".join(folded_expressions)
+
+
+def constant_of_value(value, constants):
+    """Returns the numeric value of a (folded) value if it's a constant, None
+    otherwise."""
+    match = STYLE_VARIABLE_PATTERN.match(value)
+    if match:
+        return constants.get(match.group(1))
+
+    match = STYLE_NUMBER_PATTERN.match(value)
+    if match:
+        return number_from_literal(match.group(1))
+
+    return None
+
+
+def find_style(style_name, directories):
+    for directory in directories:
+        path = os.path.join(directory, style_name + STYLE_FILE_EXTENSION)
+        if os.path.isfile(path):
+            return path
+    return None
+
+
+def fold_style(path, search_paths, imported_constants, folded_texts, report, parsing_paths):
+    """Folds a style file, and the styles it imports, adding their folded texts
+    keyed by path. Returns the constants of the style, mapping each key assigned
+    to its numeric value if it's a constant, or to None otherwise;
+    imported_constants holds the constants of each style already folded, keyed
+    by path."""
+    with open(path, encoding="utf-8", newline="") as style_file:
+        lines = style_file.read().splitlines(keepends=True)
+
+    parsing_paths.append(os.path.realpath(path))
+    constants = {}
+    groups = []
+    folded_lines = []
+
+    for number, line in enumerate(lines, 1):
+        folded_lines.append(line)
+
+        content = (line.splitlines() or [""])[0]
+        text = content.strip()
+        if not text or text.startswith(STYLE_COMMENT_PREFIX):
+            continue
+
+        match = STYLE_IMPORT_PATTERN.match(text)
+        if match:
+            imported_path = find_style(match.group(1), [os.path.dirname(path)] + search_paths)
+            if imported_path is None:
+                sys.exit("%s:%d: unable to find imported style `%s`" % (path, number, match.group(1)))
+            if os.path.realpath(imported_path) in parsing_paths:
+                sys.exit("%s:%d: cyclic import of style `%s`" % (path, number, match.group(1)))
+
+            # imported styles are folded on their own (only once), then their constants
+            # are merged into the importing style
+            imported_path = os.path.realpath(imported_path)
+            if imported_path not in imported_constants:
+                imported_constants[imported_path] = fold_style(imported_path, search_paths, imported_constants,
+                                                               folded_texts, report, parsing_paths)
+            constants.update(imported_constants[imported_path])
+            continue
+
+        match = STYLE_OPEN_GROUP_PATTERN.match(text)
+        if match:
+            groups.append(match.group(1))
+            continue
+
+        if STYLE_CLOSE_GROUP_PATTERN.match(text):
+            if not groups:
+                sys.exit("%s:%d: unmatched ending of a group of values" % (path, number))
+            groups.pop()
+            continue
+
+        match = STYLE_ASSIGNMENT_PATTERN.match(text)
+        if not match:
+            sys.exit("%s:%d: unrecognized command `%s`" % (path, number, text))
+
+        key_path = STYLE_GROUP_SEPARATOR.join(groups + [match.group(1)])
+        value = match.group(2)
+        folded = folded_value(value, constants, report)
+
+        if folded is not value:
+            # replace only the value, at the end of the trimmed line, keeping the rest
+            # of the line and its terminator
+            value_end = len(content.rstrip())
+            folded_lines[-1] = content[:value_end - len(value)] + folded + line[value_end:]
+
+        # keys that are not constants are kept as None, so that they replace the
+        # constants assigned to the same keys by the imported styles
+        constants[key_path] = constant_of_value(folded, constants)
+
+    parsing_paths.pop()
+    folded_texts[os.path.realpath(path)] = "".join(folded_lines)
+    return constants
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Folds the numerical expressions of one or more style files.")
+    parser.add_argument("styles", nargs="+", help="style files to be folded")
+    parser.add_argument("-I", dest="search_paths", action="append", default=[], metavar="DIR",
+                        help="directory where imported styles are looked up")
+    parser.add_argument("-o", "--output", required=True, metavar="DIR",
+                        help="directory where the folded styles are written")
+    args = parser.parse_args()
+
+    imported_constants = {}
+    folded_texts = {}
+    report = {"expressions": 0, "folded_expressions": 0}
+
+    for path in args.styles:
+        if os.path.realpath(path) not in folded_texts:
+            fold_style(path, args.search_paths, imported_constants, folded_texts, report, [])
+
+    os.makedirs(args.output, exist_ok=True)
+
+    for path, text in folded_texts.items():
+        with open(os.path.join(args.output, os.path.basename(path)), "w", encoding="utf-8", newline="") as output_file:
+            output_file.write(text)
+
+    sys.stderr.write("%d styles written to %s: %d of %d numerical expressions folded\n"
+                     % (len(folded_texts), args.output, report["folded_expressions"], report["expressions"]))
+
+
+if __name__ == "__main__":
+    main()
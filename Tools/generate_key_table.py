@@ -0,0 +1,237 @@
+#!/usr/bin/env python3
+#
+#  generate_key_table.py
+#  ICSStyleManager
+#
+#  Copyright (c) 2014 ice cream studios s.r.l. - http://icecreamstudios.com
+#
+#  Permission is hereby granted, free of charge, to any person obtaining a copy
+#  of this software and associated documentation files (the "Software"), to deal
+#  in the Software without restriction, including without limitation the rights
+#  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+#  copies of the Software, and to permit persons to whom the Software is
+#  furnished to do so, subject to the following conditions:
+#
+#  The above copyright notice and this permission notice shall be included in
+#  all copies or substantial portions of the Software.
+#
+#  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+#  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+#  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+#  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+#  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+#  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+#  THE SOFTWARE.
+#
+
+"""Writes the key table of one or more style files.
+
+A key table is a minimal perfect hash table holding all the keys assigned by
+the given style files (typically a style and the styles overriding it) and by
+the styles they import. It is loaded with
+-[ICSStyleManager loadKeyTable:fromBundle:], so that the value of each of its
+keys is found with a single string comparison.
+
+Usage:
+
+    generate_key_table.py Example.style Override-Example.style -o Example.stylekeys
+
+Imported styles are looked up next to the style importing them, then in the
+directories passed with -I. The values of the styles are not evaluated.
+
+The script is meant to be run by a build phase, writing the key table into the
+resources of the app:
+
+    python3 "$SRCROOT/../Tools/generate_key_table.py" Example.style \\
+        -o "$TARGET_BUILD_DIR/$UNLOCALIZED_RESOURCES_FOLDER_PATH/Example.stylekeys"
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+
+# The following definitions mirror the ones of ICSStyleManager.m
+
+STYLE_FILE_EXTENSION = ".style"
+STYLE_COMMENT_PREFIX = "//"
+STYLE_GROUP_SEPARATOR = "."
+
+STYLE_ASSIGNMENT_PATTERN = re.compile(r"\A([\w|\d|\.]*)\s*=\s*(.*)\Z")
+STYLE_OPEN_GROUP_PATTERN = re.compile(r"\A([\w|\d|\.]*)\s*\{\Z")
+STYLE_CLOSE_GROUP_PATTERN = re.compile(r"\A\}\Z")
+STYLE_IMPORT_PATTERN = re.compile(r"\A@import\s+\"([\w\-.]*)\"\Z")
+
+# Layout of the data of a key table: the header (magic, version, key count and
+# bucket count) is followed by the displacements of the buckets (int32 each), by
+# the offsets of the keys sorted by slot (uint32 each) and by the NUL terminated
+# UTF-8 keys. All the integers are stored little endian
+KEY_TABLE_MAGIC = b"ICSK"
+KEY_TABLE_VERSION = 1
+
+# Average number of keys per bucket
+KEY_TABLE_BUCKET_SIZE = 4
+
+
+def find_style(style_name, directories):
+    for directory in directories:
+        path = os.path.join(directory, style_name + STYLE_FILE_EXTENSION)
+        if os.path.isfile(path):
+            return path
+    return None
+
+
+def add_keys_of_style(path, search_paths, keys, parsing_paths):
+    """Adds the key paths assigned by a style file, and by the styles it imports,
+    in the order they are assigned."""
+    with open(path, encoding="utf-8") as style_file:
+        lines = style_file.read().splitlines()
+
+    parsing_paths.append(os.path.realpath(path))
+    groups = []
+
+    for number, line in enumerate(lines, 1):
+        text = line.strip()
+        if not text or text.startswith(STYLE_COMMENT_PREFIX):
+            continue
+
+        match = STYLE_IMPORT_PATTERN.match(text)
+        if match:
+            imported_path = find_style(match.group(1), [os.path.dirname(path)] + search_paths)
+            if imported_path is None:
+                sys.exit("%s:%d: unable to find imported style `%s`" % (path, number, match.group(1)))
+            if os.path.realpath(imported_path) in parsing_paths:
+                sys.exit("%s:%d: cyclic import of style `%s`" % (path, number, match.group(1)))
+            add_keys_of_style(imported_path, search_paths, keys, parsing_paths)
+            continue
+
+        match = STYLE_OPEN_GROUP_PATTERN.match(text)
+        if match:
+            groups.append(match.group(1))
+            continue
+
+        if STYLE_CLOSE_GROUP_PATTERN.match(text):
+            if not groups:
+                sys.exit("%s:%d: unmatched ending of a group of values" % (path, number))
+            groups.pop()
+            continue
+
+        match = STYLE_ASSIGNMENT_PATTERN.match(text)
+        if not match:
+            sys.exit("%s:%d: unrecognized command `%s`" % (path, number, text))
+
+        keys.setdefault(STYLE_GROUP_SEPARATOR.join(groups + [match.group(1)]), None)
+
+    parsing_paths.pop()
+
+
+def key_hash(key):
+    """64-bit FNV-1a hash of the UTF-8 bytes of a key: the upper half selects the
+    bucket, the lower half is mixed with the displacement of the bucket to select
+    the slot."""
+    value = 0xcbf29ce484222325
+    for byte in key:
+        value ^= byte
+        value = (value * 0x100000001b3) & 0xffffffffffffffff
+    return value
+
+
+def key_slot(value, displacement, count):
+    if displacement < 0:
+        # buckets with a single key store the slot directly
+        return -displacement - 1
+
+    # MurmurHash3 finalizer
+    slot = (value ^ displacement) & 0xffffffff
+    slot ^= slot >> 16
+    slot = (slot * 0x85ebca6b) & 0xffffffff
+    slot ^= slot >> 13
+    slot = (slot * 0xc2b2ae35) & 0xffffffff
+    slot ^= slot >> 16
+    return slot % count
+
+
+def key_table_data(keys):
+    """Returns the data of the key table of the given keys, laid out as read by
+    ICSStyleKeyTable."""
+    encoded_keys = [key.encode("utf-8") for key in keys]
+    hashes = [key_hash(key) for key in encoded_keys]
+    count = len(keys)
+    bucket_count = max((count + KEY_TABLE_BUCKET_SIZE - 1) // KEY_TABLE_BUCKET_SIZE, 1)
+
+    buckets = [[] for _ in range(bucket_count)]
+    for index, value in enumerate(hashes):
+        buckets[(value >> 32) % bucket_count].append(index)
+
+    # place the keys of the largest buckets first, while most of the slots are free
+    order = sorted(range(bucket_count), key=lambda bucket: (-len(buckets[bucket]), bucket))
+
+    displacements = [0] * bucket_count
+    slot_keys = [None] * count
+    free_slot = 0
+
+    for bucket in order:
+        indexes = buckets[bucket]
+        if not indexes:
+            break
+
+        if len(indexes) == 1:
+            # single keys go to the first free slot
+            while slot_keys[free_slot] is not None:
+                free_slot += 1
+            slot_keys[free_slot] = indexes[0]
+            displacements[bucket] = -free_slot - 1
+            continue
+
+        # look for a displacement placing all the keys of the bucket into free slots
+        displacement = 1
+        while True:
+            slots = [key_slot(hashes[index], displacement, count) for index in indexes]
+            if len(set(slots)) == len(slots) and all(slot_keys[slot] is None for slot in slots):
+                break
+            displacement += 1
+
+        for index, slot in zip(indexes, slots):
+            slot_keys[slot] = index
+        displacements[bucket] = displacement
+
+    data = bytearray(KEY_TABLE_MAGIC)
+    data += struct.pack("<III", KEY_TABLE_VERSION, count, bucket_count)
+    data += struct.pack("<%di" % bucket_count, *displacements)
+
+    strings = bytearray()
+    offsets = []
+    for index in slot_keys:
+        offsets.append(len(strings))
+        strings += encoded_keys[index] + b"\0"
+
+    data += struct.pack("<%dI" % count, *offsets)
+    data += strings
+    return bytes(data)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Writes the key table of one or more style files.")
+    parser.add_argument("styles", nargs="+", help="style files whose keys are put into the table")
+    parser.add_argument("-I", dest="search_paths", action="append", default=[], metavar="DIR",
+                        help="directory where imported styles are looked up")
+    parser.add_argument("-o", "--output", required=True, help="key table file (.stylekeys)")
+    args = parser.parse_args()
+
+    # a dictionary keeps the keys in the order they are first assigned
+    keys = {}
+    for path in args.styles:
+        add_keys_of_style(path, args.search_paths, keys, [])
+
+    data = key_table_data(list(keys))
+
+    with open(args.output, "wb") as output_file:
+        output_file.write(data)
+
+    sys.stderr.write("%d keys written to %s (%d bytes)\n" % (len(keys), args.output, len(data)))
+
+
+if __name__ == "__main__":
+    main()
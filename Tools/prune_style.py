@@ -0,0 +1,241 @@
+#!/usr/bin/env python3
+#
+#  prune_style.py
+#  ICSStyleManager
+#
+#  Copyright (c) 2014 ice cream studios s.r.l. - http://icecreamstudios.com
+#
+#  Permission is hereby granted, free of charge, to any person obtaining a copy
+#  of this software and associated documentation files (the "Software"), to deal
+#  in the Software without restriction, including without limitation the rights
+#  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+#  copies of the Software, and to permit persons to whom the Software is
+#  furnished to do so, subject to the following conditions:
+#
+#  The above copyright notice and this permission notice shall be included in
+#  all copies or substantial portions of the Software.
+#
+#  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+#  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+#  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+#  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+#  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+#  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+#  THE SOFTWARE.
+#
+
+"""Removes the keys that are never read from a style file.
+
+The unread keys files are written by -[ICSStyleManager writeUnreadKeysToFile:]
+at the end of a session, one key per line. A key is removed only if it has
+not been read in any of the sessions, i.e. if it is listed in all the unread
+keys files, and no kept value refers to it through a variable.
+
+Keys that are not listed in any unread keys file (e.g. because the style was
+not loaded during those sessions) are always kept.
+
+Usage:
+
+    prune_style.py Example.style unread-1.txt unread-2.txt > Pruned.style
+
+Styles loaded along with the pruned one (e.g. overriding styles) can refer to
+its keys through variables: pass them with --reference so that those keys are
+kept as well.
+"""
+
+import argparse
+import re
+import sys
+
+
+# The following definitions mirror the ones at the top of ICSStyleManager.m
+
+STYLE_COMMENT_PREFIX = "//"
+STYLE_GROUP_SEPARATOR = "."
+STYLE_ENVIRONMENT_PREFIX = "$"
+
+STYLE_ASSIGNMENT_PATTERN = re.compile(r"\A([\w|\d|\.]*)\s*=\s*(.*)\Z")
+STYLE_INNER_VARIABLE_PATTERN = re.compile(r"@(\$?[\w|\d|\.]*)")
+STYLE_OPEN_GROUP_PATTERN = re.compile(r"\A([\w|\d|\.]*)\s*\{\Z")
+STYLE_CLOSE_GROUP_PATTERN = re.compile(r"\A\}\Z")
+STYLE_IMPORT_PATTERN = re.compile(r"\A@import\s+\"([\w\-.]*)\"\Z")
+
+
+class Assignment(object):
+    """Line assigning a value to a key path."""
+
+    def __init__(self, line, key_path, value):
+        self.line = line
+        self.key_path = key_path
+        self.value = value
+        self.kept = False
+
+
+class Group(object):
+    """Group of values, holding its opening line, its items (lines, assignments
+    and nested groups) and its closing line."""
+
+    def __init__(self, line, name=None):
+        self.line = line
+        self.name = name
+        self.items = []
+        self.closing_line = None
+
+    def is_kept(self):
+        return any(item.kept if isinstance(item, Assignment) else item.is_kept()
+                   for item in self.items if not isinstance(item, str))
+
+
+def variable_names(value):
+    """Returns the keys referred to by the variables of a value, skipping the
+    environment values."""
+    return [name for name in STYLE_INNER_VARIABLE_PATTERN.findall(value)
+            if name and not name.startswith(STYLE_ENVIRONMENT_PREFIX)]
+
+
+def parse_style(lines, path):
+    """Parses the lines of a style file into a tree of groups, returning the
+    root group and the assignments in file order."""
+    root = Group(None)
+    stack = [root]
+    assignments = []
+
+    for number, line in enumerate(lines, 1):
+        text = line.strip()
+
+        if not text or text.startswith(STYLE_COMMENT_PREFIX) or STYLE_IMPORT_PATTERN.match(text):
+            stack[-1].items.append(line)
+            continue
+
+        match = STYLE_OPEN_GROUP_PATTERN.match(text)
+        if match:
+            group = Group(line, match.group(1))
+            stack[-1].items.append(group)
+            stack.append(group)
+            continue
+
+        if STYLE_CLOSE_GROUP_PATTERN.match(text):
+            if len(stack) == 1:
+                sys.exit("%s:%d: unmatched ending of a group of values" % (path, number))
+            stack.pop().closing_line = line
+            continue
+
+        match = STYLE_ASSIGNMENT_PATTERN.match(text)
+        if not match:
+            sys.exit("%s:%d: unrecognized command `%s`" % (path, number, text))
+
+        groups = [group.name for group in stack[1:]]
+        key_path = STYLE_GROUP_SEPARATOR.join(groups + [match.group(1)])
+        assignment = Assignment(line, key_path, match.group(2))
+        stack[-1].items.append(assignment)
+        assignments.append(assignment)
+
+    if len(stack) != 1:
+        sys.exit("%s: unterminated group of values" % path)
+
+    return root, assignments
+
+
+def referenced_keys(path):
+    """Returns the keys referred to through variables by a style file."""
+    keys = set()
+    with open(path, encoding="utf-8") as style_file:
+        for line in style_file:
+            match = STYLE_ASSIGNMENT_PATTERN.match(line.strip())
+            if match:
+                keys.update(variable_names(match.group(2)))
+    return keys
+
+
+def mark_kept_assignments(assignments, unread_keys):
+    """Keeps the last assignment of each key that has been read, then,
+    transitively, the assignments referred to by the kept values."""
+    indexes = {}
+    for index, assignment in enumerate(assignments):
+        indexes.setdefault(assignment.key_path, []).append(index)
+
+    stack = [key_indexes[-1] for key, key_indexes in indexes.items() if key not in unread_keys]
+
+    while stack:
+        index = stack.pop()
+        assignment = assignments[index]
+        if assignment.kept:
+            continue
+        assignment.kept = True
+
+        for name in variable_names(assignment.value):
+            # a variable refers to the last assignment to its key preceding this one
+            preceding = [i for i in indexes.get(name, []) if i < index]
+            if preceding:
+                stack.append(preceding[-1])
+
+
+def write_group(group, output):
+    for item in group.items:
+        if isinstance(item, str):
+            output.append(item)
+        elif isinstance(item, Assignment):
+            if item.kept:
+                output.append(item.line)
+        elif item.is_kept():
+            output.append(item.line)
+            write_group(item, output)
+            output.append(item.closing_line)
+
+
+def tidy_blank_lines(lines):
+    """Removes the blank lines left at the beginning and at the end of the groups
+    and the runs of more than two blank lines left by the removed values."""
+    tidy = []
+    for line in lines:
+        if not line.strip():
+            if tidy and (tidy[-1].rstrip().endswith("{") or (len(tidy) > 1 and not tidy[-1].strip() and not tidy[-2].strip())):
+                continue
+        elif STYLE_CLOSE_GROUP_PATTERN.match(line.strip()):
+            while tidy and not tidy[-1].strip():
+                tidy.pop()
+        tidy.append(line)
+    return tidy
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Removes the keys that are never read from a style file.")
+    parser.add_argument("style", help="style file to be pruned")
+    parser.add_argument("unread_keys", nargs="+", help="unread keys files written by writeUnreadKeysToFile:")
+    parser.add_argument("--reference", action="append", default=[], metavar="STYLE",
+                        help="style loaded along with the pruned one, whose variables may refer to its keys")
+    parser.add_argument("-o", "--output", help="pruned style file (default: standard output)")
+    args = parser.parse_args()
+
+    # a key is unread only if it hasn't been read in any of the sessions
+    unread_keys = None
+    for path in args.unread_keys:
+        with open(path, encoding="utf-8") as unread_keys_file:
+            keys = set(line.strip() for line in unread_keys_file if line.strip())
+        unread_keys = keys if unread_keys is None else unread_keys & keys
+
+    for path in args.reference:
+        unread_keys -= referenced_keys(path)
+
+    with open(args.style, encoding="utf-8") as style_file:
+        lines = style_file.read().splitlines()
+
+    root, assignments = parse_style(lines, args.style)
+    mark_kept_assignments(assignments, unread_keys)
+
+    output = []
+    write_group(root, output)
+    text = "\n".join(tidy_blank_lines(output)) + "\n"
+
+    if args.output:
+        with open(args.output, "w", encoding="utf-8") as output_file:
+            output_file.write(text)
+    else:
+        sys.stdout.write(text)
+
+    kept = sum(1 for assignment in assignments if assignment.kept)
+    sys.stderr.write("%d of %d assignments kept, %d removed\n" % (kept, len(assignments), len(assignments) - kept))
+
+
+if __name__ == "__main__":
+    main()